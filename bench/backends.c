@@ -0,0 +1,306 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * IO backends comparison: sweeps the number of monitored pipes against
+ * the fraction of them made readable per round, and measures the wakeup
+ * latency (write to the task being stepped) and the cpu time per event
+ * of each iomodule. Prints a CSV table, one row per combination.
+ *
+ *     bench_backends [-e events] > backends.csv
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/time.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/hist.h"
+#include "bench/bench.h"
+
+
+struct sweep {
+    struct caio_iomodule *iomodule;
+    size_t count;
+    size_t active;
+    size_t consumed;
+    size_t pipes;
+    int done[2];
+    unsigned long long rounds;
+    unsigned long long round;
+    unsigned long long *stamps;
+    int *readers;
+    int *writers;
+    struct caio_hist wakeup;
+};
+
+
+typedef struct reader {
+    int index;
+    struct sweep *sweep;
+} reader_t;
+
+
+typedef struct sweep driver_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY reader
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY driver
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static ASYNC
+readerA(struct caio_task *self, struct reader *reader) {
+    char c;
+    struct sweep *sweep = reader->sweep;
+    int fd = sweep->readers[reader->index];
+    CAIO_BEGIN(self);
+
+    while (true) {
+        CAIO_FILE_AWAIT(sweep->iomodule, self, fd, CAIO_IN);
+        if (read(fd, &c, 1) != 1) {
+            continue;
+        }
+
+        caio_hist_add(&sweep->wakeup,
+                bench_clock() - sweep->stamps[reader->index]);
+        sweep->consumed++;
+
+        /* The last one of the round wakes up the driver */
+        if ((sweep->consumed == sweep->active) &&
+                (write(sweep->done[1], "x", 1) != 1)) {
+            CAIO_THROW(self, errno);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(sweep->iomodule, fd);
+}
+
+
+/* Wakes up the next active readers each round, and awaits the done pipe
+ * until all of them have consumed their byte. */
+static ASYNC
+driverA(struct caio_task *self, struct sweep *sweep) {
+    char c;
+    size_t i;
+    size_t index;
+    CAIO_BEGIN(self);
+
+    for (sweep->round = 0; sweep->round < sweep->rounds; sweep->round++) {
+        sweep->consumed = 0;
+        for (i = 0; i < sweep->active; i++) {
+            index = (sweep->round * sweep->active + i) % sweep->count;
+            sweep->stamps[index] = bench_clock();
+            if (write(sweep->writers[index], "x", 1) != 1) {
+                CAIO_THROW(self, errno);
+            }
+        }
+
+        while (sweep->consumed < sweep->active) {
+            CAIO_FILE_AWAIT(sweep->iomodule, self, sweep->done[0], CAIO_IN);
+            while (read(sweep->done[0], &c, 1) == 1) {}
+        }
+    }
+
+    caio_task_killall(self->caio);
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(sweep->iomodule, sweep->done[0]);
+}
+
+
+static unsigned long long
+_cpu() {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+        (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+
+static int
+_sweep(const char *iomodule, size_t count, double ratio,
+        unsigned long long events) {
+    int i;
+    int fds[2];
+    int ret = -1;
+    struct caio *c;
+    struct sweep *sweep;
+    struct reader *readers = NULL;
+    unsigned long long ns;
+    unsigned long long cpu;
+
+    sweep = calloc(1, sizeof(struct sweep));
+    if (sweep == NULL) {
+        return -1;
+    }
+    sweep->done[0] = -1;
+    sweep->done[1] = -1;
+
+    c = caio_create(count + 1);
+    if (c == NULL) {
+        free(sweep);
+        return -1;
+    }
+
+    /* All the tasks are blocked on pipes while the backend waits */
+    sweep->iomodule = bench_iomodule_create(c, iomodule, count + 1, 1000000);
+    sweep->readers = calloc(count, sizeof(int));
+    sweep->writers = calloc(count, sizeof(int));
+    sweep->stamps = calloc(count, sizeof(unsigned long long));
+    readers = calloc(count, sizeof(struct reader));
+    if ((sweep->iomodule == NULL) || (sweep->readers == NULL) ||
+            (sweep->writers == NULL) || (sweep->stamps == NULL) ||
+            (readers == NULL)) {
+        goto terminate;
+    }
+
+    if (pipe2(sweep->done, O_NONBLOCK)) {
+        warn("pipe2");
+        goto terminate;
+    }
+
+    sweep->count = count;
+    sweep->active = count * ratio;
+    if (sweep->active < 1) {
+        sweep->active = 1;
+    }
+    sweep->rounds = events / sweep->active;
+    if (sweep->rounds < 10) {
+        sweep->rounds = 10;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (pipe2(fds, O_NONBLOCK)) {
+            warn("pipe2, count: %zu", count);
+            goto terminate;
+        }
+        sweep->readers[i] = fds[0];
+        sweep->writers[i] = fds[1];
+        sweep->pipes++;
+        readers[i].index = i;
+        readers[i].sweep = sweep;
+        reader_spawn(c, readerA, &readers[i]);
+    }
+    driver_spawn(c, driverA, sweep);
+
+    ns = bench_clock();
+    cpu = _cpu();
+    ret = caio_loop(c);
+    cpu = _cpu() - cpu;
+    ns = bench_clock() - ns;
+
+    printf("%s,%zu,%zu,%g,%lu,%.2f,%.2f,%.2f,%.1f,%.1f\n", iomodule, count,
+            sweep->active, ratio, sweep->wakeup.count,
+            caio_hist_percentile(&sweep->wakeup, 50) / 1000.0,
+            caio_hist_percentile(&sweep->wakeup, 99) / 1000.0,
+            sweep->wakeup.max / 1000.0,
+            (double)cpu / sweep->wakeup.count,
+            (double)ns / sweep->rounds);
+    fflush(stdout);
+
+terminate:
+    for (i = 0; i < sweep->pipes; i++) {
+        close(sweep->readers[i]);
+        close(sweep->writers[i]);
+    }
+
+    if (sweep->done[0] != -1) {
+        close(sweep->done[0]);
+        close(sweep->done[1]);
+    }
+    free(readers);
+    free(sweep->readers);
+    free(sweep->writers);
+    free(sweep->stamps);
+    if (sweep->iomodule) {
+        bench_iomodule_destroy(c, iomodule, sweep->iomodule);
+    }
+    caio_destroy(c);
+    free(sweep);
+    return ret;
+}
+
+
+int
+main(int argc, char **argv) {
+    int i;
+    int j;
+    int k;
+    int opt;
+    struct rlimit rl;
+    unsigned long long events = bench_iterations(100000);
+    size_t counts[] = {10, 100, 1000, 10000, 100000};
+    double ratios[] = {0.001, 0.01, 0.1, 1};
+
+    while ((opt = getopt(argc, argv, "e:")) != -1) {
+        switch (opt) {
+            case 'e':
+                events = atoll(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-e events]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    printf("iomodule,fds,active,ratio,events,wakeup_p50_us,wakeup_p99_us,"
+            "wakeup_max_us,cpu_ns_per_event,ns_per_round\n");
+    for (i = 0; bench_iomodules[i]; i++) {
+        for (j = 0; j < (sizeof(counts) / sizeof(size_t)); j++) {
+            /* A pipe takes two file descriptors */
+            if (((counts[j] * 2 + 16) > rl.rlim_cur) ||
+                    ((strcmp(bench_iomodules[i], "select") == 0) &&
+                     ((counts[j] * 2 + 16) > FD_SETSIZE))) {
+                warnx("skipping %s with %zu fds", bench_iomodules[i],
+                        counts[j]);
+                continue;
+            }
+
+            for (k = 0; k < (sizeof(ratios) / sizeof(double)); k++) {
+                _sweep(bench_iomodules[i], counts[j], ratios[k], events);
+            }
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "caio/config.h"
+#include "bench/bench.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#endif
+
+#ifdef CAIO_SELECT
+#include "caio/select.h"
+#endif
+
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+
+static const char *_sep;
+
+
+const char *bench_iomodules[] = {
+#ifdef CAIO_EPOLL
+    "epoll",
+#endif
+#ifdef CAIO_SELECT
+    "select",
+#endif
+    NULL
+};
+
+
+static int
+_counter_open(uint64_t config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+
+static unsigned long long
+_counter_read(int fd) {
+    unsigned long long value = 0;
+
+    if ((fd == -1) || (read(fd, &value, sizeof(value)) != sizeof(value))) {
+        return 0;
+    }
+
+    return value;
+}
+
+
+unsigned long long
+bench_clock() {
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+}
+
+
+unsigned long long
+bench_iterations(unsigned long long n) {
+    const char *scale = getenv("BENCH_SCALE");
+    unsigned long long scaled;
+
+    if (scale == NULL) {
+        return n;
+    }
+
+    scaled = n * atof(scale);
+    return scaled? scaled: 1;
+}
+
+
+void
+bench_suite_begin(const char *suite) {
+    printf("{\"suite\": \"%s\", \"version\": \"%s\", \"commit\": \"%s\", "
+            "\"results\": [", suite, CAIO_VERSION, BENCH_COMMIT);
+    _sep = "\n";
+    fflush(stdout);
+}
+
+
+void
+bench_suite_end() {
+    printf("\n]}\n");
+    fflush(stdout);
+}
+
+
+int
+bench_begin(struct bench *b, const char *name) {
+    memset(b, 0, sizeof(struct bench));
+    b->name = name;
+    b->cycles = _counter_open(PERF_COUNT_HW_CPU_CYCLES);
+    b->instructions = _counter_open(PERF_COUNT_HW_INSTRUCTIONS);
+
+    if (b->cycles != -1) {
+        ioctl(b->cycles, PERF_EVENT_IOC_RESET, 0);
+        ioctl(b->cycles, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    if (b->instructions != -1) {
+        ioctl(b->instructions, PERF_EVENT_IOC_RESET, 0);
+        ioctl(b->instructions, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    b->startns = bench_clock();
+    return 0;
+}
+
+
+static void
+_print_number(const char *key, double value, bool available) {
+    if (available) {
+        printf(", \"%s\": %.3f", key, value);
+    }
+    else {
+        printf(", \"%s\": null", key);
+    }
+}
+
+
+void
+bench_end(struct bench *b, unsigned long long ops, const char *params) {
+    unsigned long long cycles;
+    unsigned long long instructions;
+
+    b->ns = bench_clock() - b->startns;
+    if (b->cycles != -1) {
+        ioctl(b->cycles, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    if (b->instructions != -1) {
+        ioctl(b->instructions, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    cycles = _counter_read(b->cycles);
+    instructions = _counter_read(b->instructions);
+
+    if (ops == 0) {
+        ops = 1;
+    }
+    b->nsperop = (double)b->ns / ops;
+    b->cyclesperop = (double)cycles / ops;
+    b->instructionsperop = (double)instructions / ops;
+
+    printf("%s  {\"name\": \"%s\", \"ops\": %llu, \"ns\": %llu", _sep,
+            b->name, ops, b->ns);
+    _print_number("ns_per_op", b->nsperop, true);
+    _print_number("cycles_per_op", b->cyclesperop, cycles);
+    _print_number("instructions_per_op", b->instructionsperop,
+            instructions);
+    printf(", \"params\": {%s}}", params? params: "");
+    _sep = ",\n";
+    fflush(stdout);
+
+    if (b->cycles != -1) {
+        close(b->cycles);
+    }
+    if (b->instructions != -1) {
+        close(b->instructions);
+    }
+}
+
+
+struct caio_iomodule *
+bench_iomodule_create(struct caio *c, const char *name, size_t maxfiles,
+        unsigned int timeout_us) {
+#ifdef CAIO_EPOLL
+    if (strcmp(name, "epoll") == 0) {
+        return (struct caio_iomodule *)caio_epoll_create(c, maxfiles,
+                timeout_us / 1000);
+    }
+#endif
+
+#ifdef CAIO_SELECT
+    if (strcmp(name, "select") == 0) {
+        if (maxfiles >= FD_SETSIZE) {
+            return NULL;
+        }
+        /* The select module reserves 3 more filenos for stdio */
+        return (struct caio_iomodule *)caio_select_create(c, FD_SETSIZE - 4,
+                timeout_us);
+    }
+#endif
+
+    return NULL;
+}
+
+
+int
+bench_iomodule_destroy(struct caio *c, const char *name,
+        struct caio_iomodule *iom) {
+#ifdef CAIO_EPOLL
+    if (strcmp(name, "epoll") == 0) {
+        return caio_epoll_destroy(c, (struct caio_epoll *)iom);
+    }
+#endif
+
+#ifdef CAIO_SELECT
+    if (strcmp(name, "select") == 0) {
+        return caio_select_destroy(c, (struct caio_select *)iom);
+    }
+#endif
+
+    return -1;
+}
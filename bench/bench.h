@@ -0,0 +1,98 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef BENCH_BENCH_H_
+#define BENCH_BENCH_H_
+
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "caio/caio.h"
+
+
+/* Minimal benchmark harness: wall clock plus the cycles and instructions
+ * hardware counters of the calling thread via perf_event_open(2).
+ * Results are written to stdout as a single JSON document:
+ *
+ *     {"suite": "core", "version": "4.0.0", "commit": "abc1234",
+ *      "results": [{"name": "...", "ops": ..., "ns_per_op": ...,
+ *                   "cycles_per_op": ..., "instructions_per_op": ...,
+ *                   "params": {...}}, ...]}
+ *
+ * Counters which are not available (i.e. perf_event_paranoid or no PMU in
+ * a VM) are written as null. */
+struct bench {
+    const char *name;
+    int cycles;
+    int instructions;
+    unsigned long long startns;
+    unsigned long long ns;
+    unsigned long long startcycles;
+    unsigned long long startinstructions;
+    double nsperop;
+    double cyclesperop;
+    double instructionsperop;
+};
+
+
+void
+bench_suite_begin(const char *suite);
+
+
+void
+bench_suite_end();
+
+
+int
+bench_begin(struct bench *b, const char *name);
+
+
+/* Stop the counters and report ops operations, params is an optional JSON
+ * object body, i.e. "\"maxtasks\": 1000". */
+void
+bench_end(struct bench *b, unsigned long long ops, const char *params);
+
+
+/* Number of iterations, overridable by the BENCH_SCALE environment
+ * variable as a multiplier, i.e. BENCH_SCALE=0.1 for a quick run. */
+unsigned long long
+bench_iterations(unsigned long long n);
+
+
+unsigned long long
+bench_clock();
+
+
+/* NULL terminated names of the iomodules built in this tree */
+extern const char *bench_iomodules[];
+
+
+/* Create the named iomodule able to monitor file descriptors up to
+ * maxfiles, waiting at most timeout_us when idle. */
+struct caio_iomodule *
+bench_iomodule_create(struct caio *c, const char *name, size_t maxfiles,
+        unsigned int timeout_us);
+
+
+int
+bench_iomodule_destroy(struct caio *c, const char *name,
+        struct caio_iomodule *iom);
+
+
+#endif  // BENCH_BENCH_H_
@@ -0,0 +1,292 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Core micro-benchmarks: task lease/release, await round trip, generator
+ * yield, loop iteration cost versus the pool size and module dispatch.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/resource.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "bench/bench.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#endif
+
+
+typedef struct runner {
+    unsigned long long count;
+    unsigned long long value;
+    struct caio_iomodule *iomodule;
+    int fd;
+} runner_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY runner
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+typedef struct generator {
+    unsigned long long current;
+} generator_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY generator
+#define CAIO_ARG1 unsigned long long *
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static ASYNC
+nopA(struct caio_task *self, struct runner *state) {
+    CAIO_BEGIN(self);
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+awaiterA(struct caio_task *self, struct runner *state) {
+    CAIO_BEGIN(self);
+    while (state->count--) {
+        CAIO_AWAIT(self, runner, nopA, state);
+    }
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+producerA(struct caio_task *self, struct generator *state,
+        unsigned long long *out) {
+    CAIO_BEGIN(self);
+    *out = state->current++;
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+consumerA(struct caio_task *self, struct runner *state) {
+    static struct generator generator = {0};
+    CAIO_BEGIN(self);
+    while (state->count--) {
+        CAIO_AWAIT(self, generator, producerA, &generator, &state->value);
+    }
+    CAIO_FINALLY(self);
+}
+
+
+/* Loops until the count, then terminates all the other tasks */
+static ASYNC
+yielderA(struct caio_task *self, struct runner *state) {
+    CAIO_BEGIN(self);
+    while (state->count--) {
+        CAIO_AWAIT(self, runner, nopA, state);
+    }
+    caio_task_killall(self->caio);
+    CAIO_FINALLY(self);
+}
+
+
+#ifdef CAIO_EPOLL
+
+/* Waits forever for a pipe which is never written */
+static ASYNC
+waiterA(struct caio_task *self, struct runner *state) {
+    CAIO_BEGIN(self);
+    CAIO_FILE_AWAIT(state->iomodule, self, state->fd, CAIO_IN);
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(state->iomodule, state->fd);
+    close(state->fd);
+}
+
+#endif
+
+
+static void
+_spawn_dispose() {
+    unsigned long long i;
+    unsigned long long n = bench_iterations(10000000);
+    struct bench b;
+    struct caio_task *task;
+    struct caio *c = caio_create(1);
+
+    if (c == NULL) {
+        err(EXIT_FAILURE, "caio_create");
+    }
+
+    bench_begin(&b, "spawn_dispose");
+    for (i = 0; i < n; i++) {
+        task = caio_task_new(c);
+        caio_task_dispose(task);
+    }
+    bench_end(&b, n, NULL);
+    caio_destroy(c);
+}
+
+
+static void
+_await(const char *name, runner_coro coro) {
+    struct bench b;
+    struct runner state = {.count = bench_iterations(10000000)};
+    unsigned long long n = state.count;
+    struct caio *c = caio_create(1);
+
+    if (c == NULL) {
+        err(EXIT_FAILURE, "caio_create");
+    }
+
+    runner_spawn(c, coro, &state);
+    bench_begin(&b, name);
+    caio_loop(c);
+    bench_end(&b, n, NULL);
+    caio_destroy(c);
+}
+
+
+static int
+_nooptick(struct caio_module *m, struct caio *c) {
+    return 0;
+}
+
+
+static void
+_modules(int count) {
+    int i;
+    char params[64];
+    struct bench b;
+    struct caio_module modules[CAIO_MODULES_MAX] = {0};
+    struct runner state = {.count = bench_iterations(5000000)};
+    unsigned long long n = state.count;
+    struct caio *c = caio_create(1);
+
+    if (c == NULL) {
+        err(EXIT_FAILURE, "caio_create");
+    }
+
+    for (i = 0; i < count; i++) {
+        modules[i].tick = _nooptick;
+        caio_module_install(c, &modules[i]);
+    }
+
+    runner_spawn(c, yielderA, &state);
+    bench_begin(&b, "module_dispatch");
+    caio_loop(c);
+
+    /* Each await takes two loop iterations */
+    snprintf(params, sizeof(params), "\"modules\": %d", count);
+    bench_end(&b, n * 2, params);
+    caio_destroy(c);
+}
+
+
+#ifdef CAIO_EPOLL
+
+static void
+_tick(size_t maxtasks) {
+    int i;
+    int fds[2];
+    char params[64];
+    struct bench b;
+    struct caio_epoll *epoll;
+    struct runner *waiters;
+    struct runner state;
+    unsigned long long n;
+    struct caio *c = caio_create(maxtasks);
+
+    /* Each iteration scans the whole pool */
+    n = 20000000 / maxtasks;
+    state.count = n = bench_iterations((n > 200000)? 200000: n);
+
+    if (c == NULL) {
+        err(EXIT_FAILURE, "caio_create");
+    }
+
+    epoll = caio_epoll_create(c, maxtasks, 0);
+    waiters = calloc(maxtasks, sizeof(struct runner));
+    if ((epoll == NULL) || (waiters == NULL) || pipe(fds)) {
+        err(EXIT_FAILURE, "tick setup");
+    }
+
+    for (i = 0; i < (maxtasks - 1); i++) {
+        waiters[i].iomodule = (struct caio_iomodule *)epoll;
+        waiters[i].fd = dup(fds[0]);
+        if (waiters[i].fd == -1) {
+            warn("dup, waiters: %d", i);
+            break;
+        }
+        runner_spawn(c, waiterA, &waiters[i]);
+    }
+
+    runner_spawn(c, yielderA, &state);
+    bench_begin(&b, "loop_tick");
+    caio_loop(c);
+    snprintf(params, sizeof(params), "\"maxtasks\": %zu, \"waiting\": %d",
+            maxtasks, i);
+    bench_end(&b, n * 2, params);
+
+    close(fds[0]);
+    close(fds[1]);
+    free(waiters);
+    caio_epoll_destroy(c, epoll);
+    caio_destroy(c);
+}
+
+#endif
+
+
+int
+main() {
+    int i;
+    struct rlimit rl;
+
+    /* Enough files for the largest pool of waiting tasks */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    bench_suite_begin("core");
+    _spawn_dispose();
+    _await("await_roundtrip", awaiterA);
+    _await("generator_yield", consumerA);
+    for (i = 0; i <= CAIO_MODULES_MAX; i += (i? i: 1)) {
+        _modules(i);
+    }
+
+#ifdef CAIO_EPOLL
+    size_t maxtasks[] = {10, 100, 1000, 10000};
+    for (i = 0; i < (sizeof(maxtasks) / sizeof(size_t)); i++) {
+        _tick(maxtasks[i]);
+    }
+#endif
+    bench_suite_end();
+    return EXIT_SUCCESS;
+}
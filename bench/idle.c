@@ -0,0 +1,452 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Memory per idle connection. A caio server, in a child process, accepts
+ * the given number of loopback connections which are then kept idle, and
+ * reports the heap bytes of each component per connection, it's RSS
+ * growth and the loop iteration time with all of them waiting.
+ *
+ *     bench_idle [-n connections[,connections...]]
+ *
+ * The connections are limited by RLIMIT_NOFILE (raised to the hard limit)
+ * and the ephemeral ports, client sockets are spread over 127.0.0.x source
+ * addresses to reach beyond the latter.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <malloc.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "bench/bench.h"
+
+
+/* Connections per source address, below the ephemeral ports range */
+#define PERSOURCE 25000
+#define TICKS 10000
+
+
+static struct caio *_caio;
+
+
+struct report {
+    size_t connections;
+    double taskpool;
+    double frame;
+    double state;
+    double iomodule;
+    double rss;
+    double tickns;
+};
+
+
+typedef struct server {
+    int fd;
+    int report;
+    size_t target;
+    size_t accepted;
+    size_t heap;
+    size_t rss;
+    unsigned long long ticks;
+    unsigned long long start;
+    struct caio_iomodule *iomodule;
+    struct report result;
+} server_t;
+
+
+typedef struct idleconn {
+    int fd;
+    struct server *server;
+} idleconn_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY server
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY idleconn
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+/* Heap bytes in use, including the large (mmaped) allocations */
+static size_t
+_heap() {
+    struct mallinfo2 mi = mallinfo2();
+
+    return mi.uordblks + mi.hblkhd;
+}
+
+
+static size_t
+_rss() {
+    long pages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f == NULL) {
+        return 0;
+    }
+
+    if (fscanf(f, "%*s %ld", &pages) != 1) {
+        pages = 0;
+    }
+    fclose(f);
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+
+static ASYNC
+idleA(struct caio_task *self, struct idleconn *conn) {
+    static char buff[256];
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        CAIO_FILE_AWAIT(conn->server->iomodule, self, conn->fd, CAIO_IN);
+        bytes = read(conn->fd, buff, sizeof(buff));
+        if ((bytes == 0) || ((bytes == -1) && !IO_MUSTWAIT(errno))) {
+            break;
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(conn->server->iomodule, conn->fd);
+    close(conn->fd);
+    free(conn);
+}
+
+
+static ASYNC
+nopA(struct caio_task *self, struct server *server) {
+    CAIO_BEGIN(self);
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+listenA(struct caio_task *self, struct server *server) {
+    int fd;
+    struct idleconn *conn;
+    CAIO_BEGIN(self);
+
+    while (server->accepted < server->target) {
+        fd = accept4(server->fd, NULL, NULL, SOCK_NONBLOCK);
+        if ((fd == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(server->iomodule, self, server->fd, CAIO_IN);
+            continue;
+        }
+
+        if (fd == -1) {
+            CAIO_THROW(self, errno);
+        }
+
+        conn = malloc(sizeof(struct idleconn));
+        if (conn == NULL) {
+            CAIO_THROW(self, errno);
+        }
+
+        conn->fd = fd;
+        conn->server = server;
+        if (idleconn_spawn(_caio, idleA, conn)) {
+            close(fd);
+            free(conn);
+            CAIO_THROW(self, ENOSPC);
+        }
+        server->accepted++;
+    }
+
+    server->result.frame = (double)(_heap() - server->heap) /
+        server->accepted;
+    server->result.rss = (double)(_rss() - server->rss) / server->accepted;
+
+    /* Loop iterations with all the connections waiting, an await takes
+     * two iterations. */
+    server->start = bench_clock();
+    for (server->ticks = 0; server->ticks < TICKS; server->ticks++) {
+        CAIO_AWAIT(self, server, nopA, server);
+    }
+    server->result.tickns = (double)(bench_clock() - server->start) /
+        (TICKS * 2);
+
+    server->result.connections = server->accepted;
+    if (write(server->report, &server->result, sizeof(struct report)) !=
+            sizeof(struct report)) {
+        CAIO_THROW(self, errno);
+    }
+
+    /* Wait for the SIGTERM */
+    while (true) {
+        CAIO_FILE_AWAIT(server->iomodule, self, server->fd, CAIO_IN);
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(server->iomodule, server->fd);
+}
+
+
+static void
+_sighandler(int s) {
+    caio_task_killall(_caio);
+}
+
+
+static int
+_serve(int fd, int report, size_t connections) {
+    size_t heap;
+    size_t maxfiles = connections + 16;
+    struct server server = {
+        .fd = fd,
+        .report = report,
+        .target = connections,
+    };
+    struct sigaction sa = {{_sighandler}, {{0, 0, 0, 0}}};
+    struct idleconn *probe;
+
+    sigaction(SIGTERM, &sa, NULL);
+    server.rss = _rss();
+    heap = _heap();
+    _caio = caio_create(connections + 1);
+    if (_caio == NULL) {
+        return -1;
+    }
+    server.result.taskpool = (double)(_heap() - heap) / (connections + 1);
+
+    /* Never waits, the bench measures the loop's own cost */
+    heap = _heap();
+    server.iomodule = bench_iomodule_create(_caio, bench_iomodules[0],
+            maxfiles, 0);
+    if (server.iomodule == NULL) {
+        caio_destroy(_caio);
+        return -1;
+    }
+    server.result.iomodule = (double)(_heap() - heap) / maxfiles;
+
+    /* Usable size plus the chunk header */
+    probe = malloc(sizeof(struct idleconn));
+    if (probe == NULL) {
+        return -1;
+    }
+    server.result.state = malloc_usable_size(probe) + sizeof(size_t);
+    free(probe);
+
+    server.heap = _heap();
+    server_spawn(_caio, listenA, &server);
+    caio_loop(_caio);
+    bench_iomodule_destroy(_caio, bench_iomodules[0], server.iomodule);
+    return caio_destroy(_caio);
+}
+
+
+static long
+_slab() {
+    long kb = -1;
+    char line[256];
+    FILE *f = fopen("/proc/meminfo", "r");
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "Slab: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+
+static int
+_connect(struct sockaddr_in *server, size_t index) {
+    int fd;
+    int option = 1;
+    struct sockaddr_in source = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK + (index / PERSOURCE)),
+        .sin_port = 0,
+    };
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    /* Choose the port at connect, considering the destination */
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &option,
+            sizeof(option));
+    if (bind(fd, (struct sockaddr *)&source, sizeof(source)) ||
+            connect(fd, (struct sockaddr *)server, sizeof(*server))) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+static int
+_run(size_t connections) {
+    int i;
+    int fd;
+    int pipefd[2];
+    pid_t pid;
+    long slab;
+    char params[512];
+    struct bench b;
+    struct report report;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    socklen_t addrlen = sizeof(addr);
+    int *clients;
+
+    clients = calloc(connections, sizeof(int));
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if ((clients == NULL) || (fd == -1) || pipe(pipefd) ||
+            bind(fd, (struct sockaddr *)&addr, addrlen) ||
+            listen(fd, 4096) ||
+            getsockname(fd, (struct sockaddr *)&addr, &addrlen)) {
+        err(EXIT_FAILURE, "setup");
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        err(EXIT_FAILURE, "fork");
+    }
+
+    if (pid == 0) {
+        close(pipefd[0]);
+        exit(_serve(fd, pipefd[1], connections)? EXIT_FAILURE:
+                EXIT_SUCCESS);
+    }
+    close(fd);
+    close(pipefd[1]);
+
+    slab = _slab();
+    bench_begin(&b, "idle");
+    for (i = 0; i < connections; i++) {
+        clients[i] = _connect(&addr, i);
+        if (clients[i] == -1) {
+            warn("connect #%d", i);
+            break;
+        }
+    }
+
+    if ((i < connections) ||
+            (read(pipefd[0], &report, sizeof(report)) != sizeof(report))) {
+        memset(&report, 0, sizeof(report));
+    }
+
+    /* Both ends of the sockets, system wide. The frames are what remains
+     * of the heap growth after the user state. */
+    slab = _slab() - slab;
+    snprintf(params, sizeof(params), "\"connections\": %zu, "
+            "\"iomodule\": \"%s\", \"taskpool_bytes\": %.1f, "
+            "\"frame_bytes\": %.1f, \"state_bytes\": %.1f, "
+            "\"iomodule_bytes\": %.1f, \"rss_bytes\": %.1f, "
+            "\"kernel_slab_bytes\": %.1f, \"tick_ns\": %.1f",
+            report.connections, bench_iomodules[0], report.taskpool,
+            report.frame - report.state, report.state, report.iomodule,
+            report.rss, connections? slab * 1024.0 / connections: 0,
+            report.tickns);
+    bench_end(&b, i, params);
+
+    while (i--) {
+        close(clients[i]);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    close(pipefd[0]);
+    free(clients);
+    return report.connections == connections? 0: -1;
+}
+
+
+int
+main(int argc, char **argv) {
+    int opt;
+    int ret = EXIT_SUCCESS;
+    char *list = NULL;
+    char *token;
+    char *saveptr;
+    size_t connections;
+    size_t limit;
+    struct rlimit rl;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n':
+                list = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n connections[,...]]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    limit = rl.rlim_cur - 64;
+
+    list = strdup(list? list: "1000,10000,100000,1000000");
+    if (list == NULL) {
+        err(EXIT_FAILURE, "strdup");
+    }
+
+    bench_suite_begin("idle");
+    for (token = strtok_r(list, ",", &saveptr); token;
+            token = strtok_r(NULL, ",", &saveptr)) {
+        connections = atol(token);
+        if (connections > limit) {
+            warnx("skipping %zu connections, RLIMIT_NOFILE: %zu",
+                    connections, limit + 64);
+            continue;
+        }
+
+        if (_run(connections)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+    bench_suite_end();
+
+    free(list);
+    return ret;
+}
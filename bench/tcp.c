@@ -0,0 +1,480 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Loopback TCP echo throughput and latency, both the server and the load
+ * generator are caio loops. The server runs in a child process once per
+ * iomodule, the load generator keeps connections clients busy with depth
+ * pipelined requests of payload bytes each for the given duration.
+ *
+ *     bench_tcp [-c connections] [-d depth] [-s payload] [-t seconds]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/hist.h"
+#include "bench/bench.h"
+
+
+#define BUFFSIZE 16384
+
+
+static struct caio *_caio;
+
+
+typedef struct server {
+    int fd;
+    struct caio_iomodule *iomodule;
+} server_t;
+
+
+typedef struct conn {
+    int fd;
+    size_t length;
+    size_t written;
+    struct server *server;
+    char buff[BUFFSIZE];
+} conn_t;
+
+
+struct load {
+    int depth;
+    size_t payload;
+    unsigned long long deadline;
+    unsigned long long requests;
+    unsigned long errors;
+    struct caio_hist latency;
+};
+
+
+typedef struct client {
+    int fd;
+    struct sockaddr_in addr;
+    struct caio_iomodule *iomodule;
+    struct load *load;
+    char *buff;
+    size_t size;
+    size_t sent;
+    size_t received;
+    size_t next;
+    unsigned long long start;
+} client_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY server
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY conn
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY client
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static ASYNC
+echoA(struct caio_task *self, struct conn *conn) {
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        bytes = read(conn->fd, conn->buff, BUFFSIZE);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(conn->server->iomodule, self, conn->fd, CAIO_IN);
+            continue;
+        }
+
+        if (bytes <= 0) {
+            break;
+        }
+
+        conn->length = bytes;
+        conn->written = 0;
+        while (conn->written < conn->length) {
+            bytes = write(conn->fd, conn->buff + conn->written,
+                    conn->length - conn->written);
+            if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+                CAIO_FILE_AWAIT(conn->server->iomodule, self, conn->fd,
+                        CAIO_OUT);
+                continue;
+            }
+
+            if (bytes <= 0) {
+                CAIO_RETURN(self);
+            }
+            conn->written += bytes;
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(conn->server->iomodule, conn->fd);
+    close(conn->fd);
+    free(conn);
+}
+
+
+static ASYNC
+listenA(struct caio_task *self, struct server *server) {
+    int fd;
+    int option = 1;
+    struct conn *conn;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        fd = accept4(server->fd, NULL, NULL, SOCK_NONBLOCK);
+        if ((fd == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(server->iomodule, self, server->fd, CAIO_IN);
+            continue;
+        }
+
+        if (fd == -1) {
+            CAIO_THROW(self, errno);
+        }
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+        conn = malloc(sizeof(struct conn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+
+        conn->fd = fd;
+        conn->server = server;
+        if (conn_spawn(_caio, echoA, conn)) {
+            close(fd);
+            free(conn);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(server->iomodule, server->fd);
+}
+
+
+static ASYNC
+clientA(struct caio_task *self, struct client *client) {
+    ssize_t bytes;
+    int option = 1;
+    socklen_t optlen = sizeof(option);
+    struct load *load = client->load;
+    CAIO_BEGIN(self);
+
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (client->fd == -1) {
+        CAIO_THROW(self, errno);
+    }
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &option, sizeof(option));
+
+    if (connect(client->fd, (struct sockaddr *)&client->addr,
+                sizeof(client->addr))) {
+        if (errno != EINPROGRESS) {
+            CAIO_THROW(self, errno);
+        }
+
+        CAIO_FILE_AWAIT(client->iomodule, self, client->fd, CAIO_OUT);
+        getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &option, &optlen);
+        if (option) {
+            CAIO_THROW(self, option);
+        }
+    }
+
+    while (bench_clock() < load->deadline) {
+        client->start = bench_clock();
+
+        /* Pipelined requests */
+        client->sent = 0;
+        while (client->sent < client->size) {
+            bytes = write(client->fd, client->buff + client->sent,
+                    client->size - client->sent);
+            if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+                CAIO_FILE_AWAIT(client->iomodule, self, client->fd, CAIO_OUT);
+                continue;
+            }
+
+            if (bytes <= 0) {
+                CAIO_THROW(self, bytes? errno: EPIPE);
+            }
+            client->sent += bytes;
+        }
+
+        /* Responses arrive in order, a request completes with it's last
+         * byte. */
+        client->received = 0;
+        client->next = load->payload;
+        while (client->received < client->size) {
+            bytes = read(client->fd, client->buff,
+                    client->size - client->received);
+            if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+                CAIO_FILE_AWAIT(client->iomodule, self, client->fd, CAIO_IN);
+                continue;
+            }
+
+            if (bytes <= 0) {
+                CAIO_THROW(self, bytes? errno: EPIPE);
+            }
+
+            client->received += bytes;
+            while (client->received >= client->next) {
+                caio_hist_add(&load->latency, bench_clock() - client->start);
+                load->requests++;
+                client->next += load->payload;
+            }
+        }
+    }
+
+    CAIO_FINALLY(self);
+    if (CAIO_HASERROR(self)) {
+        load->errors++;
+    }
+
+    if (client->fd != -1) {
+        CAIO_FILE_FORGET(client->iomodule, client->fd);
+        close(client->fd);
+    }
+}
+
+
+static void
+_sighandler(int s) {
+    caio_task_killall(_caio);
+}
+
+
+static int
+_serve(int fd, const char *iomodule, int connections) {
+    struct server server = {.fd = fd};
+    struct sigaction sa = {{_sighandler}, {{0, 0, 0, 0}}};
+
+    sigaction(SIGTERM, &sa, NULL);
+    _caio = caio_create(connections + 1);
+    if (_caio == NULL) {
+        return -1;
+    }
+
+    server.iomodule = bench_iomodule_create(_caio, iomodule,
+            connections + 8, 10000);
+    if (server.iomodule == NULL) {
+        caio_destroy(_caio);
+        return -1;
+    }
+
+    server_spawn(_caio, listenA, &server);
+    caio_loop(_caio);
+    bench_iomodule_destroy(_caio, iomodule, server.iomodule);
+    return caio_destroy(_caio);
+}
+
+
+static int
+_load(struct sockaddr_in *addr, struct load *load, int connections,
+        int seconds) {
+    int i;
+    int ret = 0;
+    struct caio *c;
+    struct caio_iomodule *iom;
+    struct client *clients;
+
+    c = caio_create(connections);
+    if (c == NULL) {
+        return -1;
+    }
+
+    iom = bench_iomodule_create(c, bench_iomodules[0], connections + 8,
+            10000);
+    clients = calloc(connections, sizeof(struct client));
+    if ((iom == NULL) || (clients == NULL)) {
+        ret = -1;
+        goto terminate;
+    }
+
+    load->deadline = bench_clock() + seconds * 1000000000ULL;
+    for (i = 0; i < connections; i++) {
+        clients[i].fd = -1;
+        clients[i].addr = *addr;
+        clients[i].iomodule = iom;
+        clients[i].load = load;
+        clients[i].size = load->depth * load->payload;
+        clients[i].buff = malloc(clients[i].size);
+        if (clients[i].buff == NULL) {
+            ret = -1;
+            goto terminate;
+        }
+        memset(clients[i].buff, 'x', clients[i].size);
+        client_spawn(c, clientA, &clients[i]);
+    }
+
+    ret = caio_loop(c);
+
+terminate:
+    if (clients) {
+        for (i = 0; i < connections; i++) {
+            free(clients[i].buff);
+        }
+        free(clients);
+    }
+
+    if (iom) {
+        bench_iomodule_destroy(c, bench_iomodules[0], iom);
+    }
+    caio_destroy(c);
+    return ret;
+}
+
+
+static int
+_listen(struct sockaddr_in *addr, int backlog) {
+    int fd;
+    int option = 1;
+    socklen_t addrlen = sizeof(struct sockaddr_in);
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->sin_port = 0;
+    if (bind(fd, (struct sockaddr *)addr, addrlen) || listen(fd, backlog) ||
+            getsockname(fd, (struct sockaddr *)addr, &addrlen)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+int
+main(int argc, char **argv) {
+    int i;
+    int opt;
+    int fd;
+    pid_t pid;
+    int connections = 64;
+    int depth = 1;
+    size_t payload = 64;
+    int seconds = 3;
+    char params[256];
+    struct bench b;
+    struct sockaddr_in addr;
+    struct load *load;
+
+    while ((opt = getopt(argc, argv, "c:d:s:t:")) != -1) {
+        switch (opt) {
+            case 'c':
+                connections = atoi(optarg);
+                break;
+            case 'd':
+                depth = atoi(optarg);
+                break;
+            case 's':
+                payload = atol(optarg);
+                break;
+            case 't':
+                seconds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-c connections] [-d depth] "
+                        "[-s payload] [-t seconds]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if ((connections < 1) || (depth < 1) || (payload < 1) || (seconds < 1)) {
+        errx(EXIT_FAILURE, "invalid arguments");
+    }
+
+    /* Huge histogram, not on the stack */
+    load = malloc(sizeof(struct load));
+    if (load == NULL) {
+        err(EXIT_FAILURE, "malloc");
+    }
+
+    bench_suite_begin("tcp");
+    for (i = 0; bench_iomodules[i]; i++) {
+        fd = _listen(&addr, connections);
+        if (fd == -1) {
+            err(EXIT_FAILURE, "listen");
+        }
+
+        pid = fork();
+        if (pid == -1) {
+            err(EXIT_FAILURE, "fork");
+        }
+
+        if (pid == 0) {
+            exit(_serve(fd, bench_iomodules[i], connections)?
+                    EXIT_FAILURE: EXIT_SUCCESS);
+        }
+        close(fd);
+
+        memset(load, 0, sizeof(struct load));
+        load->depth = depth;
+        load->payload = payload;
+        bench_begin(&b, "echo");
+        if (_load(&addr, load, connections, seconds)) {
+            warn("load, iomodule: %s", bench_iomodules[i]);
+        }
+
+        snprintf(params, sizeof(params), "\"iomodule\": \"%s\", "
+                "\"connections\": %d, \"depth\": %d, \"payload\": %zu, "
+                "\"rps\": %.0f, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+                "\"p999_us\": %.1f, \"max_us\": %.1f, \"errors\": %lu",
+                bench_iomodules[i], connections, depth, payload,
+                load->requests / (seconds * 1.0),
+                caio_hist_percentile(&load->latency, 50) / 1000.0,
+                caio_hist_percentile(&load->latency, 99) / 1000.0,
+                caio_hist_percentile(&load->latency, 99.9) / 1000.0,
+                load->latency.max / 1000.0, load->errors);
+        bench_end(&b, load->requests, params);
+
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+    bench_suite_end();
+
+    free(load);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "caio/config.h"
+#include "caio/arena.h"
+
+
+#define ALIGNMENT _Alignof(max_align_t)
+#define ALIGN(n) (((n) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+
+static struct caio_arenachunk *
+_chunk(struct caio_arenacache *cache, size_t size) {
+    struct caio_arenachunk *chunk;
+
+    if ((size <= CAIO_ARENA_CHUNKSIZE) && cache->chunks) {
+        chunk = cache->chunks;
+        cache->chunks = chunk->next;
+        cache->count--;
+        chunk->used = 0;
+        return chunk;
+    }
+
+    if (size < CAIO_ARENA_CHUNKSIZE) {
+        size = CAIO_ARENA_CHUNKSIZE;
+    }
+
+    chunk = malloc(sizeof(struct caio_arenachunk) + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+
+void *
+caio_arena_alloc(struct caio_arena *a, size_t size) {
+    void *p;
+    struct caio_arenachunk *chunk = a->chunk;
+
+    if (size > (SIZE_MAX - ALIGNMENT)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    size = ALIGN(size);
+
+    if ((chunk == NULL) || ((chunk->size - chunk->used) < size)) {
+        chunk = _chunk(a->cache, size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+
+        chunk->next = a->chunk;
+        a->chunk = chunk;
+    }
+
+    p = (char *)chunk->data + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+
+void *
+caio_arena_calloc(struct caio_arena *a, size_t count, size_t size) {
+    void *p;
+
+    if (size && (count > (SIZE_MAX / size))) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    p = caio_arena_alloc(a, count * size);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+
+    return p;
+}
+
+
+char *
+caio_arena_strndup(struct caio_arena *a, const char *s, size_t size) {
+    char *p;
+
+    size = strnlen(s, size);
+    p = caio_arena_alloc(a, size + 1);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    memcpy(p, s, size);
+    p[size] = '\0';
+    return p;
+}
+
+
+void
+caio_arena_reset(struct caio_arena *a) {
+    struct caio_arenachunk *chunk;
+
+    while ((chunk = a->chunk)) {
+        a->chunk = chunk->next;
+        if (chunk->size != CAIO_ARENA_CHUNKSIZE) {
+            free(chunk);
+            continue;
+        }
+
+        chunk->next = a->cache->chunks;
+        a->cache->chunks = chunk;
+        a->cache->count++;
+    }
+}
+
+
+void
+caio_arenacache_deinit(struct caio_arenacache *cache) {
+    struct caio_arenachunk *chunk;
+
+    while ((chunk = cache->chunks)) {
+        cache->chunks = chunk->next;
+        free(chunk);
+    }
+
+    cache->count = 0;
+}
@@ -0,0 +1,74 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_ARENA_H_
+#define CAIO_ARENA_H_
+
+
+#include <stddef.h>
+
+
+/* Chunked bump allocator for the request scoped objects, see
+ * caio_task_arena. There is no free, everything is given back at once by
+ * caio_arena_reset. The chunks are recycled through a cache of the loop, so
+ * the steady state never touches malloc(3). */
+struct caio_arenachunk {
+    struct caio_arenachunk *next;
+    size_t size;
+    size_t used;
+    max_align_t data[];
+};
+
+
+/* The chunks of CAIO_ARENA_CHUNKSIZE usable bytes, the larger ones are
+ * freed as soon as they are given back. */
+struct caio_arenacache {
+    struct caio_arenachunk *chunks;
+    size_t count;
+};
+
+
+struct caio_arena {
+    struct caio_arenacache *cache;
+    struct caio_arenachunk *chunk;
+};
+
+
+/* Aligned for any type, NULL and ENOMEM when out of memory. */
+void *
+caio_arena_alloc(struct caio_arena *a, size_t size);
+
+
+void *
+caio_arena_calloc(struct caio_arena *a, size_t count, size_t size);
+
+
+char *
+caio_arena_strndup(struct caio_arena *a, const char *s, size_t size);
+
+
+/* Give all the chunks back to the cache. */
+void
+caio_arena_reset(struct caio_arena *a);
+
+
+void
+caio_arenacache_deinit(struct caio_arenacache *cache);
+
+
+#endif  // CAIO_ARENA_H_
@@ -18,21 +18,118 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
 
 #include "caio/caio.h"
 #include "caio/taskpool.h"
+#include "caio/trace.h"
+#include "caio/probes.h"
+#include "caio/symbol.h"
+
+#ifdef CAIO_STATS
+#include "caio/stats.h"
+#endif
+
+#ifdef CAIO_PROFILE
+#include "caio/profile.h"
+#endif
+
+#ifdef CAIO_SAMPLER
+#include "caio/sampler.h"
+#endif
 
 
 struct caio {
     struct caio_taskpool taskpool;
+
+    /* Time of the current loop iteration, after the ticks */
+    unsigned long long now;
+    caio_clock clock;
+    void *clockarg;
+
+    /* Maximum blocking time of the iomodules, set by caio_loop_once */
+    unsigned long long waitlimit;
+
+    /* Some task may be runnable in the next iteration, set by the steps,
+     * spawns and wakeups, so the ticks don't have to scan the pool */
+    bool runnable;
+
+    /* Tasks inspector */
+    FILE *dumpout;
+    unsigned long dumpsignals;
+#ifdef CAIO_STATS
+    uint32_t dumprequests;
+#endif
 #ifdef CAIO_MODULES
     struct caio_module *modules[CAIO_MODULES_MAX];
     size_t modulescount;
 #endif  // CAIO_MODULES
+#ifdef CAIO_STATS
+    struct caio_stats stats;
+    struct caio_statspage *statspage;
+    char *statsfile;
+#endif  // CAIO_STATS
+#ifdef CAIO_LAG
+    struct caio_lag lag;
+    caio_shedpolicy shedpolicy;
+    void *shedarg;
+    double shedpercentile;
+    unsigned long long shedthreshold;
+    int shedding;
+#endif  // CAIO_LAG
+#ifdef CAIO_TRACE
+    struct caio_tracering *trace;
+#endif
+#ifdef CAIO_ARENA
+    struct caio_arenacache arenacache;
+#endif
 };
 
 
+static inline unsigned long long
+_clock() {
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+}
+
+
+static inline unsigned long long
+_now(struct caio *c) {
+    if (c->clock) {
+        return c->clock(c->clockarg);
+    }
+
+#ifdef CAIO_COARSECLOCK
+    return caio_clock_gettime(CLOCK_MONOTONIC_COARSE);
+#else
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+#endif
+}
+
+
+unsigned long long
+caio_now(struct caio *c) {
+    return c->now;
+}
+
+
+int
+caio_clock_set(struct caio *c, caio_clock clock, void *arg) {
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->clock = clock;
+    c->clockarg = arg;
+    c->now = _now(c);
+    return 0;
+}
+
+
 struct caio*
 caio_create(size_t maxtasks) {
     struct caio *c = malloc(sizeof(struct caio));
@@ -44,6 +141,40 @@ caio_create(size_t maxtasks) {
     c->modulescount = 0;
 #endif  // CAIO_MODULES
 
+    c->clock = NULL;
+    c->clockarg = NULL;
+    c->now = _now(c);
+    c->waitlimit = ULLONG_MAX;
+    c->runnable = true;
+    c->dumpout = NULL;
+    c->dumpsignals = 0;
+#ifdef CAIO_STATS
+    c->dumprequests = 0;
+#endif
+
+#ifdef CAIO_STATS
+    memset(&c->stats, 0, sizeof(struct caio_stats));
+    c->statspage = NULL;
+    c->statsfile = NULL;
+#endif  // CAIO_STATS
+
+#ifdef CAIO_LAG
+    caio_hist_reset(&c->lag.lag);
+    caio_hist_reset(&c->lag.iteration);
+    c->shedpolicy = NULL;
+    c->shedarg = NULL;
+    c->shedding = -1;
+#endif  // CAIO_LAG
+
+#ifdef CAIO_TRACE
+    c->trace = NULL;
+#endif
+
+#ifdef CAIO_ARENA
+    c->arenacache.chunks = NULL;
+    c->arenacache.count = 0;
+#endif
+
     /* Initialize task pool */
     if (caio_taskpool_init(&c->taskpool, maxtasks)) {
         goto onerror;
@@ -67,6 +198,21 @@ caio_destroy(struct caio *c) {
         return -1;
     }
 
+#ifdef CAIO_STATS
+    if (c->statspage) {
+        caio_statspage_destroy(c->statspage, c->statsfile);
+        free(c->statsfile);
+    }
+#endif  // CAIO_STATS
+
+#ifdef CAIO_TRACE
+    caio_trace_stop(c);
+#endif
+
+#ifdef CAIO_ARENA
+    caio_arenacache_deinit(&c->arenacache);
+#endif
+
     free(c);
     errno = 0;
     return 0;
@@ -84,6 +230,9 @@ caio_task_new(struct caio *c) {
     }
 
     task->caio = c;
+    task->laststep = c->now;
+    c->runnable = true;
+    CAIO_TRACE_EVENT(SPAWN, task, 0, 0);
     return task;
 }
 
@@ -94,6 +243,17 @@ caio_task_dispose(struct caio_task *task) {
 }
 
 
+#ifdef CAIO_ARENA
+
+struct caio_arena *
+caio_task_arena(struct caio_task *task) {
+    task->arena.cache = &task->caio->arenacache;
+    return &task->arena;
+}
+
+#endif  // CAIO_ARENA
+
+
 void
 caio_task_killall(struct caio *c) {
     struct caio_task *task = NULL;
@@ -102,6 +262,36 @@ caio_task_killall(struct caio *c) {
                     CAIO_RUNNING | CAIO_WAITING))) {
         task->status = CAIO_TERMINATING;
     }
+    c->runnable = true;
+
+    /* Pending calls will be handed over to the tasks being released just to
+     * run their finally block. */
+    if (c->taskpool.pending.count) {
+        c->taskpool.pending.cancel = true;
+    }
+}
+
+
+void
+caio_task_wake(struct caio_task *task, enum caio_taskstatus status) {
+    task->status = status;
+    task->caio->runnable = true;
+}
+
+
+bool
+caio_runnable(struct caio *c) {
+    return c->runnable;
+}
+
+
+unsigned long long
+caio_waitlimit(struct caio *c) {
+    if (c->runnable) {
+        return 0;
+    }
+
+    return c->waitlimit;
 }
 
 
@@ -154,12 +344,272 @@ caio_module_uninstall(struct caio *c, struct caio_module *m) {
 }
 
 
+#ifdef CAIO_IOMODULES
+
+int
+caio_iomodule_fileno(struct caio_iomodule *iom) {
+    if (iom == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (iom->pollable == NULL) {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    return iom->pollable(iom);
+}
+
+#endif  // CAIO_IOMODULES
+#endif  // CAIO_MODULES
+
+
+#ifdef CAIO_STATS
+
+void
+caio_stats_frame(struct caio *c) {
+    c->stats.frames++;
+}
+
+
+int
+caio_stats_get(struct caio *c, struct caio_stats *stats) {
+    int i;
+    struct caio_iostats *io;
+    struct caio_taskpool *taskpool;
+
+    if ((c == NULL) || (stats == NULL)) {
+        return -1;
+    }
+
+    taskpool = &c->taskpool;
+    *stats = c->stats;
+    stats->tasks = taskpool->count;
+    stats->maxtasks = taskpool->size;
+    stats->leases = taskpool->leases;
+    stats->releases = taskpool->releases;
+    stats->spawnfailures = taskpool->exhausted;
+
+#ifdef CAIO_MODULES
+    for (i = 0; i < c->modulescount; i++) {
+        io = &c->modules[i]->iostats;
+        stats->io.waits += io->waits;
+        stats->io.events += io->events;
+        stats->io.ctls += io->ctls;
+        stats->io.waitns += io->waitns;
+        stats->io.waitingfiles += io->waitingfiles;
+    }
 #endif  // CAIO_MODULES
 
+    return 0;
+}
+
+
+int
+caio_stats_share(struct caio *c, const char *filename) {
+    if ((c == NULL) || (filename == NULL) || c->statspage) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->statsfile = strdup(filename);
+    if (c->statsfile == NULL) {
+        return -1;
+    }
+
+    c->statspage = caio_statspage_create(filename);
+    if (c->statspage == NULL) {
+        free(c->statsfile);
+        c->statsfile = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static inline void
+_stats_publish(struct caio *c) {
+    struct caio_stats stats;
+
+    if (c->statspage == NULL) {
+        return;
+    }
+
+    caio_stats_get(c, &stats);
+    caio_statspage_publish(c->statspage, &stats);
+}
+
+#endif  // CAIO_STATS
+
+
+#ifdef CAIO_LAG
+
+/* Number of samples after which the lag histograms decay */
+#define LAG_WINDOW 4096
+
+
+static inline void
+_lag_add(struct caio_hist *h, unsigned long long value) {
+    if (h->count >= LAG_WINDOW) {
+        caio_hist_decay(h);
+    }
+
+    caio_hist_add(h, value);
+}
+
+
+static bool
+_shed_threshold(struct caio *c, const struct caio_lag *lag, void *arg) {
+    return caio_hist_percentile(&lag->lag, c->shedpercentile) >
+        c->shedthreshold;
+}
+
+
+const struct caio_lag *
+caio_lag_get(struct caio *c) {
+    if (c == NULL) {
+        return NULL;
+    }
+
+    return &c->lag;
+}
+
+
+int
+caio_shed_threshold(struct caio *c, double percentile,
+        unsigned long long threshold_ns) {
+    if ((c == NULL) || (percentile <= 0) || (percentile > 100)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->shedpercentile = percentile;
+    c->shedthreshold = threshold_ns;
+    return caio_shed_policy(c, _shed_threshold, NULL);
+}
+
+
+int
+caio_shed_policy(struct caio *c, caio_shedpolicy policy, void *arg) {
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->shedpolicy = policy;
+    c->shedarg = arg;
+    c->shedding = -1;
+    return 0;
+}
+
+
+bool
+caio_shed(struct caio *c) {
+    if (c->shedpolicy == NULL) {
+        return false;
+    }
+
+    if (c->shedding == -1) {
+        c->shedding = c->shedpolicy(c, &c->lag, c->shedarg);
+    }
+
+    return c->shedding;
+}
+
+#endif  // CAIO_LAG
+
+
+#ifdef CAIO_TRACE
+
+int
+caio_trace_start(struct caio *c, size_t capacity) {
+    if ((c == NULL) || c->trace) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    c->trace = caio_tracering_create(capacity);
+    if (c->trace == NULL) {
+        return -1;
+    }
+
+    caio_trace_current = c->trace;
+    return 0;
+}
+
+
+int
+caio_trace_stop(struct caio *c) {
+    if ((c == NULL) || (c->trace == NULL)) {
+        return -1;
+    }
+
+    caio_tracering_destroy(c->trace);
+    c->trace = NULL;
+    return 0;
+}
+
+
+int
+caio_trace_dump(struct caio *c, FILE *out) {
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return caio_tracering_dump(c->trace, out, c->taskpool.tasks,
+            c->taskpool.size);
+}
+
+#endif  // CAIO_TRACE
+
+
+#ifdef CAIO_PROFILE
+
+/* The slot of the point the task is being resumed from, a suspended task
+ * carries it's slot and the suspension time. */
+static inline struct caio_profslot *
+_profile_resume(struct caio_task *task, struct caio_basecall *call,
+        unsigned long long now) {
+    struct caio_profslot *slot = task->profslot;
+
+    if (slot == NULL) {
+        return caio_profile_slot(call->function, call->line);
+    }
+
+    caio_profile_add(&slot->wait, now - task->profts);
+    task->profslot = NULL;
+    return slot;
+}
+
+
+static inline void
+_profile_suspend(struct caio_task *task, struct caio_basecall *call,
+        struct caio_profslot *slot, unsigned long long start) {
+    unsigned long long now = _clock();
+
+    if (slot) {
+        caio_profile_add(&slot->cpu, now - start);
+    }
+
+    if (task->status == CAIO_WAITING) {
+        task->profslot = caio_profile_slot(call->function, call->line);
+        task->profts = now;
+    }
+}
+
+#endif  // CAIO_PROFILE
+
 
 static inline bool
 _step(struct caio_task *task) {
     struct caio_basecall *call = task->current;
+#ifdef CAIO_PROFILE
+    struct caio_profslot *profslot;
+    unsigned long long profstart;
+#endif
 
 start:
     /* Pre execution */
@@ -171,7 +621,24 @@ start:
         default:
     }
 
+#ifdef CAIO_PROFILE
+    profstart = _clock();
+    profslot = _profile_resume(task, call, profstart);
+#endif
+#ifdef CAIO_SAMPLER
+    caio_sampler_task = task;
+#endif
+    CAIO_TRACE_EVENT(STEPBEGIN, task, call->function, call->line);
+    CAIO_PROBE3(step_begin, task, call->function, call->line);
     call->invoke(task);
+    CAIO_PROBE3(step_end, task, call->function, task->status);
+    CAIO_TRACE_EVENT(STEPEND, task, call->function, task->status);
+#ifdef CAIO_SAMPLER
+    caio_sampler_task = NULL;
+#endif
+#ifdef CAIO_PROFILE
+    _profile_suspend(task, call, profslot, profstart);
+#endif
 
     /* Post execution */
     switch (task->status) {
@@ -180,9 +647,17 @@ start:
         case CAIO_TERMINATED:
             task->current = call->parent;
             free(call);
+#ifdef CAIO_STATS
+            task->caio->stats.framefrees++;
+#endif
             if (task->current != NULL) {
                 task->status = CAIO_RUNNING;
             }
+#ifdef CAIO_ARENA
+            else if (task->arena.chunk) {
+                caio_arena_reset(&task->arena);
+            }
+#endif
             break;
         default:
     }
@@ -191,13 +666,366 @@ start:
 }
 
 
+/* Run the finally block of a never started call on a placeholder task */
+static void
+_pending_drop(struct caio *c, struct caio_basecall *call, int eno) {
+    struct caio_task task = {
+        .caio = c,
+        .current = call,
+        .status = CAIO_TERMINATING,
+        .eno = eno,
+    };
+
+    while (!_step(&task)) {
+        task.status = CAIO_TERMINATING;
+    }
+}
+
+
+/* The spawns dropping the oldest call run inside the step of a task, so the
+ * dropped calls are finalized by the loop afterwards */
+static void
+_pending_defer(struct caio_taskqueue *q, struct caio_basecall *call) {
+    call->parent = NULL;
+    if (q->droppedtail) {
+        q->droppedtail->parent = call;
+    }
+    else {
+        q->dropped = call;
+    }
+    q->droppedtail = call;
+}
+
+
+static void
+_pending_finalize(struct caio *c) {
+    struct caio_taskqueue *q = &c->taskpool.pending;
+    struct caio_basecall *call;
+
+    while ((call = q->dropped)) {
+        q->dropped = call->parent;
+        if (q->dropped == NULL) {
+            q->droppedtail = NULL;
+        }
+
+        call->parent = NULL;
+        _pending_drop(c, call, ECANCELED);
+    }
+}
+
+
+static void
+_pending_expire(struct caio *c) {
+    struct caio_taskqueue *q = &c->taskpool.pending;
+    const struct caio_pendingcall *head;
+    unsigned long long now;
+
+    if ((q->maxwait == 0) || (q->count == 0)) {
+        return;
+    }
+
+    now = c->now;
+    while ((head = caio_taskqueue_head(q)) &&
+            ((now - head->queued) > q->maxwait)) {
+        q->metrics.expired++;
+        _pending_drop(c, caio_taskqueue_pop(q, NULL), ETIMEDOUT);
+    }
+}
+
+
 int
-caio_loop(struct caio *c) {
+caio_admission(struct caio *c, size_t size, unsigned long long maxwait_ns,
+        enum caio_admissionpolicy policy) {
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return caio_taskqueue_init(&c->taskpool.pending, size, maxwait_ns,
+            policy);
+}
+
+
+const struct caio_admission *
+caio_admission_get(struct caio *c) {
+    if (c == NULL) {
+        return NULL;
+    }
+
+    c->taskpool.pending.metrics.pending = c->taskpool.pending.count;
+    return &c->taskpool.pending.metrics;
+}
+
+
+bool
+caio_admission_full(struct caio *c) {
+    struct caio_taskqueue *q = &c->taskpool.pending;
+
+    if (q->size == 0) {
+        return true;
+    }
+
+    return (q->count == q->size) && (q->policy == CAIO_ADMISSION_DROPNEWEST);
+}
+
+
+int
+caio_task_enqueue(struct caio *c, struct caio_basecall *call) {
+    struct caio_taskqueue *q = &c->taskpool.pending;
+
+    if (call == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (q->size == 0) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    if (q->count == q->size) {
+        if (q->policy != CAIO_ADMISSION_DROPOLDEST) {
+            errno = ENOSPC;
+            return -1;
+        }
+
+        q->metrics.dropped++;
+        _pending_defer(q, caio_taskqueue_pop(q, NULL));
+    }
+
+    CAIO_TRACE_EVENT(SPAWN, NULL, 0, 0);
+    return caio_taskqueue_push(q, call, c->now);
+}
+
+
+static const char *
+_statusname(enum caio_taskstatus status) {
+    switch (status) {
+        case CAIO_IDLE:
+            return "idle";
+        case CAIO_RUNNING:
+            return "running";
+        case CAIO_WAITING:
+            return "waiting";
+        case CAIO_TERMINATING:
+            return "terminating";
+        case CAIO_TERMINATED:
+            return "terminated";
+        default:
+            return "unknown";
+    }
+}
+
+
+int
+caio_dump_tasks(struct caio *c, FILE *out) {
+    int index = 0;
+    char name[256];
+    unsigned long long now;
+    struct caio_task *task = NULL;
+    struct caio_basecall *call;
+    struct caio_taskpool *pool;
+
+    if ((c == NULL) || (out == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    now = _now(c);
+    pool = &c->taskpool;
+    fprintf(out, "tasks: %zu/%zu, pending: %zu\n", pool->count, pool->size,
+            pool->pending.count);
+    while ((task = caio_taskpool_next(pool, task, ~CAIO_IDLE))) {
+        index = task - pool->tasks;
+        fprintf(out, "#%d %s, eno: %d, idle: %.3fms", index,
+                _statusname(task->status), task->eno,
+                (now - task->laststep) / 1000000.0);
+        if ((task->status == CAIO_WAITING) && (task->fd != -1)) {
+            fprintf(out, ", fd: %d, events:%s%s%s", task->fd,
+                    (task->events & CAIO_IN)? " in": "",
+                    (task->events & CAIO_OUT)? " out": "",
+                    (task->events & CAIO_ERR)? " err": "");
+        }
+        fprintf(out, "\n");
+
+        for (call = task->current; call; call = call->parent) {
+            caio_symbol(call->function, name, sizeof(name));
+            fprintf(out, "    %s:%d\n", name, call->line);
+        }
+    }
+
+    return fflush(out);
+}
+
+
+static volatile sig_atomic_t _dumpsignals;
+
+
+static void
+_dump_signal(int signo) {
+    _dumpsignals++;
+}
+
+
+static void
+_dump_check(struct caio *c) {
+    bool requested = false;
+
+    if (_dumpsignals != c->dumpsignals) {
+        c->dumpsignals = _dumpsignals;
+        requested = true;
+    }
+
+#ifdef CAIO_STATS
+    uint32_t requests;
+
+    if (c->statspage) {
+        requests = __atomic_load_n(&c->statspage->dumprequests,
+                __ATOMIC_ACQUIRE);
+        if (requests != c->dumprequests) {
+            c->dumprequests = requests;
+            requested = true;
+        }
+    }
+#endif
+
+    if (requested) {
+        caio_dump_tasks(c, c->dumpout);
+    }
+}
+
+
+int
+caio_dump_trigger(struct caio *c, int signo, FILE *out) {
+    struct sigaction sa;
+
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (signo) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = _dump_signal;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(signo, &sa, NULL)) {
+            return -1;
+        }
+    }
+
+    c->dumpout = out? out: stderr;
+    c->dumpsignals = _dumpsignals;
+#ifdef CAIO_STATS
+    if (c->statspage) {
+        c->dumprequests = __atomic_load_n(&c->statspage->dumprequests,
+                __ATOMIC_ACQUIRE);
+    }
+#endif
+    return 0;
+}
+
+
+/* Signals caught by the sampler or the inspector must not stop the loop */
+static inline bool
+_eintr_ignore(struct caio *c) {
+    bool ignore = false;
+
+    if (errno != EINTR) {
+        return false;
+    }
+
+#ifdef CAIO_SAMPLER
+    ignore |= caio_sampler_interrupted();
+#endif
+
+    return ignore || (c->dumpout && (_dumpsignals != c->dumpsignals));
+}
+
+
+/* One loop iteration: tick the modules and step the runnable tasks */
+static int
+_iterate(struct caio *c) {
     struct caio_task *task = NULL;
     struct caio_taskpool *taskpool = &c->taskpool;
     struct caio_module *module;
     int i;
     int ret;
+#ifdef CAIO_LAG
+    unsigned long long start = _clock();
+    unsigned long long ready;
+#endif
+
+#ifdef CAIO_SAMPLER
+    caio_sampler_interrupted();
+#endif
+    for (i = 0; i < c->modulescount; i++) {
+        module = c->modules[i];
+        CAIO_TRACE_EVENT(TICKBEGIN, NULL, module, i);
+        ret = module->tick ? module->tick(module, c) : 0;
+        CAIO_TRACE_EVENT(TICKEND, NULL, module, i);
+        if (ret && !_eintr_ignore(c)) {
+            return -1;
+        }
+    }
+
+    c->now = _now(c);
+    _pending_expire(c);
+
+#ifdef CAIO_STATS
+    c->stats.ticks++;
+    c->stats.runnable = 0;
+#endif
+#ifdef CAIO_LAG
+    ready = _clock();
+    c->shedding = -1;
+#endif
+    c->runnable = false;
+    while ((task = caio_taskpool_next(taskpool, task,
+                CAIO_RUNNING | CAIO_TERMINATING))) {
+#ifdef CAIO_STATS
+        c->stats.runnable++;
+#endif
+#ifdef CAIO_LAG
+        _lag_add(&c->lag.lag, _clock() - ready);
+#endif
+        task->laststep = c->now;
+        if (_step(task)) {
+            CAIO_TRACE_EVENT(TERMINATE, task, 0, task->eno);
+            caio_taskpool_release(taskpool, task);
+        }
+
+        /* Yielded, awaits a new call or handed over to a pending one */
+        if (task->status & (CAIO_RUNNING | CAIO_TERMINATING)) {
+            c->runnable = true;
+        }
+    }
+    _pending_finalize(c);
+#ifdef CAIO_STATS
+    c->stats.steps += c->stats.runnable;
+    _stats_publish(c);
+#endif
+#ifdef CAIO_LAG
+    _lag_add(&c->lag.iteration, _clock() - start);
+#endif
+    if (c->dumpout) {
+        _dump_check(c);
+    }
+
+    return 0;
+}
+
+
+int
+caio_loop(struct caio *c) {
+    struct caio_taskpool *taskpool = &c->taskpool;
+    struct caio_module *module;
+    int i;
+    int ret;
+
+#ifdef CAIO_TRACE
+    caio_trace_current = c->trace;
+#endif
 
     for (i = 0; i < c->modulescount; i++) {
         module = c->modules[i];
@@ -208,18 +1036,8 @@ caio_loop(struct caio *c) {
 
 loop:
     while (taskpool->count) {
-        for (i = 0; i < c->modulescount; i++) {
-            module = c->modules[i];
-            if (module->tick && module->tick(module, c)) {
-                goto interrupt;
-            }
-        }
-
-        while ((task = caio_taskpool_next(taskpool, task,
-                    CAIO_RUNNING | CAIO_TERMINATING))) {
-            if (_step(task)) {
-                caio_taskpool_release(taskpool, task);
-            }
+        if (_iterate(c)) {
+            goto interrupt;
         }
     }
 
@@ -243,3 +1061,52 @@ interrupt:
     caio_task_killall(c);
     goto loop;
 }
+
+
+int
+caio_loop_once(struct caio *c, unsigned long long timeout_ns) {
+    int ret;
+
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#ifdef CAIO_TRACE
+    caio_trace_current = c->trace;
+#endif
+
+    c->waitlimit = timeout_ns;
+    ret = _iterate(c);
+    c->waitlimit = ULLONG_MAX;
+    if (ret) {
+        caio_task_killall(c);
+        return -1;
+    }
+
+    return c->taskpool.count;
+}
+
+
+int
+caio_loop_run_for(struct caio *c, unsigned long long duration_ns) {
+    int ret;
+    unsigned long long now;
+    unsigned long long deadline;
+
+    if (c == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    now = _now(c);
+    deadline = (duration_ns > (ULLONG_MAX - now))?
+        ULLONG_MAX: now + duration_ns;
+
+    do {
+        ret = caio_loop_once(c, deadline - now);
+        now = c->now;
+    } while ((ret > 0) && (now < deadline));
+
+    return ret;
+}
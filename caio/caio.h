@@ -20,7 +20,17 @@
 #define CAIO_CAIO_H_
 
 
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+
 #include "caio/config.h"
+#include "caio/hist.h"
+
+#ifdef CAIO_ARENA
+#include "caio/arena.h"
+#endif
 
 
 enum caio_taskstatus {
@@ -41,6 +51,9 @@ struct caio_basecall {
     struct caio_basecall *parent;
     int line;
     caio_invoker invoke;
+
+    /* The coroutine, for profilers and debuggers */
+    const void *function;
 };
 
 
@@ -49,9 +62,106 @@ struct caio_task {
     struct caio_basecall *current;
     enum caio_taskstatus status;
     int eno;
+
+    /* For the inspector: the last file awaited and the loop iteration's
+     * time of the last step, see caio_dump_tasks. */
+    int fd;
+    int events;
+    unsigned long long laststep;
+#ifdef CAIO_PROFILE
+    struct caio_profslot *profslot;
+    unsigned long long profts;
+#endif
+#ifdef CAIO_ARENA
+    struct caio_arena arena;
+#endif
+};
+
+
+/* Statistics */
+#ifdef CAIO_STATS
+
+/* Maintained by the iomodules, and summed up by the caio_stats_get */
+struct caio_iostats {
+    unsigned long waits;
+    unsigned long events;
+    unsigned long ctls;
+    unsigned long long waitns;
+    size_t waitingfiles;
+};
+
+
+struct caio_stats {
+    /* caio_loop */
+    unsigned long ticks;
+    unsigned long steps;
+    size_t runnable;
+
+    /* caio_taskpool */
+    size_t tasks;
+    size_t maxtasks;
+    unsigned long leases;
+    unsigned long releases;
+    unsigned long spawnfailures;
+
+    /* call frames */
+    unsigned long frames;
+    unsigned long framefrees;
+
+    /* iomodules */
+    struct caio_iostats io;
 };
 
 
+int
+caio_stats_get(struct caio *c, struct caio_stats *stats);
+
+
+void
+caio_stats_frame(struct caio *c);
+
+#endif  // CAIO_STATS
+
+
+/* Loop lag and overload shedding */
+#ifdef CAIO_LAG
+
+/* Moving histograms in nanoseconds. lag is the time from the iomodules
+ * harvesting the readiness events to each task actually being stepped,
+ * iteration is the duration of the whole caio_loop iteration. */
+struct caio_lag {
+    struct caio_hist lag;
+    struct caio_hist iteration;
+};
+
+
+typedef bool (*caio_shedpolicy) (struct caio *c, const struct caio_lag *lag,
+        void *arg);
+
+
+const struct caio_lag *
+caio_lag_get(struct caio *c);
+
+
+/* Builtin policy: shed when the given percentile of lag exceeds the
+ * threshold. */
+int
+caio_shed_threshold(struct caio *c, double percentile,
+        unsigned long long threshold_ns);
+
+
+int
+caio_shed_policy(struct caio *c, caio_shedpolicy policy, void *arg);
+
+
+/* Accept loops may consult this to pause accepting or fast-reject new
+ * work, the policy is evaluated at most once per loop iteration. */
+bool
+caio_shed(struct caio *c);
+
+#endif  // CAIO_LAG
+
+
 /* Modules */
 #ifdef CAIO_MODULES
 
@@ -61,6 +171,9 @@ struct caio_module {
     caio_hook loopstart;
     caio_hook tick;
     caio_hook loopend;
+#ifdef CAIO_STATS
+    struct caio_iostats iostats;
+#endif
 };
 
 
@@ -71,18 +184,56 @@ struct caio_iomodule;
 typedef int (*caio_filemonitor) (struct caio_iomodule *iom,
         struct caio_task *task, int fd, int events);
 typedef int (*caio_fileforget) (struct caio_iomodule *iom, int fd);
+typedef int (*caio_pollable) (struct caio_iomodule *iom);
+
+
+/* Persistent, level-triggered, callback style registration of a file, for
+ * hosting the foreign libraries, see caio/foreign.h. The callback is
+ * called from the iomodule's tick with the ready events, and the watcher
+ * must remain valid until the next tick after it's removed. */
+struct caio_watcher;
+typedef void (*caio_watchcallback) (struct caio_watcher *w, int events);
+struct caio_watcher {
+    int fd;
+    int events;
+    caio_watchcallback callback;
+
+    /* Maintained by the iomodule */
+    bool active;
+};
+
+
+/* Adds, modifies, or with zero events, removes the watcher */
+typedef int (*caio_filewatch) (struct caio_iomodule *iom,
+        struct caio_watcher *w);
+
+
+#ifdef __cplusplus
+/* g++ has no anonymous struct members, a base is laid out the same */
+struct caio_iomodule: caio_module {
+#else
 struct caio_iomodule {
     struct caio_module;
+#endif
     caio_filemonitor monitor;
     caio_fileforget forget;
+
+    /* Optional, see caio_iomodule_fileno */
+    caio_pollable pollable;
+
+    /* Optional, see caio_watcher */
+    caio_filewatch watch;
 };
 
 
 #define CAIO_FILE_FORGET(iomodule, fd) (iomodule)->forget(iomodule, fd)
-#define CAIO_FILE_AWAIT(iomodule, task, fd, events) \
+#define CAIO_FILE_AWAIT(iomodule, task, file, filevents) \
     do { \
         (task)->current->line = __LINE__; \
-        if ((iomodule)->monitor(iomodule, task, fd, events)) { \
+        (task)->fd = (file); \
+        (task)->events = (filevents); \
+        if ((iomodule)->monitor(iomodule, task, (task)->fd, \
+                    (task)->events)) { \
             (task)->status = CAIO_TERMINATING; \
         } \
         else { \
@@ -100,6 +251,13 @@ caio_module_install(struct caio *c, struct caio_module *m);
 int
 caio_module_uninstall(struct caio *c, struct caio_module *m);
 
+
+/* A file which becomes readable when the iomodule has events, so a host
+ * event loop can poll(2) it and step caio only when there is work. -1 and
+ * ENOTSUP if the iomodule has none, like select(2). */
+int
+caio_iomodule_fileno(struct caio_iomodule *iom);
+
 #endif  // CAIO_IOMODULES
 #endif  // CAIO_MODULES
 
@@ -120,14 +278,143 @@ int
 caio_task_dispose(struct caio_task *task);
 
 
+#ifdef CAIO_ARENA
+
+/* The task's bump allocator for the request scoped objects. Reset it with
+ * caio_arena_reset at the request boundaries, it's reset anyway when the
+ * task terminates. */
+struct caio_arena *
+caio_task_arena(struct caio_task *task);
+
+#endif  // CAIO_ARENA
+
+
+/* Admission queue: when there is no idle task, spawns are queued instead of
+ * being rejected, and get a task as soon as one is released. Queued calls
+ * which are dropped or waited more than maxwait are terminated without
+ * being started: they jump directly into their CAIO_FINALLY with eno set to
+ * ECANCELED or ETIMEDOUT. */
+enum caio_admissionpolicy {
+    CAIO_ADMISSION_DROPNEWEST,
+    CAIO_ADMISSION_DROPOLDEST,
+};
+
+
+struct caio_admission {
+    unsigned long queued;
+    unsigned long admitted;
+    unsigned long expired;
+    unsigned long dropped;
+    size_t pending;
+#ifdef CAIO_STATS
+    struct caio_hist queuetime;
+#endif
+};
+
+
+/* size zero disables the queue, maxwait zero means forever */
+int
+caio_admission(struct caio *c, size_t size, unsigned long long maxwait_ns,
+        enum caio_admissionpolicy policy);
+
+
+const struct caio_admission *
+caio_admission_get(struct caio *c);
+
+
+/* True if a spawn would be rejected when there is no idle task. */
+bool
+caio_admission_full(struct caio *c);
+
+
+int
+caio_task_enqueue(struct caio *c, struct caio_basecall *call);
+
+
 void
 caio_task_killall(struct caio* c);
 
 
+/* Moves another task to CAIO_RUNNING or CAIO_TERMINATING. Modules and
+ * tasks waking up or killing tasks other than themselves must use this,
+ * otherwise the iomodules may block although the task is runnable. */
+void
+caio_task_wake(struct caio_task *task, enum caio_taskstatus status);
+
+
+/* clock_gettime(2) in nanoseconds */
+static inline unsigned long long
+caio_clock_gettime(clockid_t clock) {
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* Monotonic time in nanoseconds, read once per caio_loop iteration right
+ * after the iomodules' ticks. Cheaper than clock_gettime(2) for stamping
+ * requests and checking deadlines, and it's what the admission queue and
+ * the timeouts are measured with. */
+unsigned long long
+caio_now(struct caio *c);
+
+
+/* Replace the CLOCK_MONOTONIC source of caio_now, for example with a
+ * virtual clock, see caio_sim_now. NULL restores the default. */
+typedef unsigned long long (*caio_clock) (void *arg);
+int
+caio_clock_set(struct caio *c, caio_clock clock, void *arg);
+
+
+/* True if any task may be stepped in this loop iteration, iomodules must
+ * not block or advance their time in their tick then. It's a flag kept by
+ * the loop rather than a scan of the taskpool, so it may be true for an
+ * iteration which has nothing to step. */
+bool
+caio_runnable(struct caio *c);
+
+
+/* How long the iomodules may block in their tick: zero when a task is
+ * runnable, the remaining timeout of caio_loop_once, or ULLONG_MAX
+ * meaning their own timeout. */
+unsigned long long
+caio_waitlimit(struct caio *c);
+
+
+/* Write all the non-idle tasks with their status, error, time since their
+ * last step, the file they are waiting for and their frame chain. */
+int
+caio_dump_tasks(struct caio *c, FILE *out);
+
+
+/* Let the loop dump the tasks into out (stderr if NULL) whenever the signo
+ * is received, or a dump is requested through the shared stats page, see
+ * caio_stats_requestdump. signo zero means no signal. */
+int
+caio_dump_trigger(struct caio *c, int signo, FILE *out);
+
+
 int
 caio_loop(struct caio* c);
 
 
+/* Run a single loop iteration, blocking at most timeout_ns in the
+ * iomodules, for embedding caio into another event loop. Step it whenever
+ * the iomodule's fileno is readable, see caio_iomodule_fileno, or
+ * caio_runnable is true. The loopstart and loopend hooks are not called.
+ * Returns the number of the remaining tasks, or -1 if an iomodule fails,
+ * then all the tasks are killed and must be stepped to their end. */
+int
+caio_loop_once(struct caio* c, unsigned long long timeout_ns);
+
+
+/* Like caio_loop_once, but keeps iterating for duration_ns of caio_now or
+ * until no task remains. */
+int
+caio_loop_run_for(struct caio* c, unsigned long long duration_ns);
+
+
 /* Generic stuff */
 #define CAIO_NAME_PASTER(x, y) x ## _ ## y
 #define CAIO_NAME_EVALUATOR(x, y)  CAIO_NAME_PASTER(x, y)
@@ -146,6 +433,15 @@ caio_loop(struct caio* c);
     } while (0)
 
 
+/* Let the other runnable tasks step, and resume in the next iteration */
+#define CAIO_YIELD(task) \
+    do { \
+        (task)->current->line = __LINE__; \
+        return; \
+        case __LINE__:; \
+    } while (0)
+
+
 #define CAIO_BEGIN(task) \
     switch ((task)->current->line) { \
         case 0:
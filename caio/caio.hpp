@@ -0,0 +1,660 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Header-only C++20 coroutines over the caio tasks and iomodules:
+ *
+ *     caiopp::task<> echo(struct caio_iomodule *iom, int fd) {
+ *         char buff[1024];
+ *         ssize_t bytes;
+ *
+ *         while ((bytes = co_await caiopp::read(iom, fd, buff, 1024)) > 0) {
+ *             co_await caiopp::write(iom, fd, buff, bytes);
+ *         }
+ *     }
+ *
+ *     caiopp::spawn(c, echo(iom, fd));
+ *     caio_loop(c);
+ *
+ * Each spawned caiopp::task<> occupies a task of the pool and is stepped by
+ * caio_loop like any other. Awaiting another caiopp::task<T> runs it on the
+ * same caio task, the C coroutines can be awaited as well, see caiopp::call.
+ *
+ * The awaiters return zero or an errno, ECANCELED once the task is killed,
+ * so the coroutine can unwind without exceptions. Awaiting again after that
+ * throws caiopp::cancelled, which ends the spawned coroutine quietly. Other
+ * exceptions propagate through the awaited caiopp::task<T>s, but must not
+ * leave the spawned one.
+ *
+ * The coroutine frames are recycled by a per thread free list of size
+ * classes, so there is no malloc(3) in the steady state.
+ *
+ * The namespace is caiopp, since caio is taken by the struct caio. The
+ * other caio headers must be included within an extern "C" block.
+ */
+#ifndef CAIO_CAIO_HPP_
+#define CAIO_CAIO_HPP_
+
+
+#include <unistd.h>
+#include <errno.h>
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <exception>
+#include <coroutine>
+
+extern "C" {
+#include "caio/config.h"
+#include "caio/caio.h"
+#ifdef CAIO_IOMODULES
+#include "caio/sleep.h"
+#endif
+}
+
+
+namespace caiopp {
+
+
+/* Thrown by the awaiters of a killed task which is awaited again */
+struct cancelled: std::exception {
+    const char *
+    what() const noexcept override {
+        return "caiopp::cancelled";
+    }
+};
+
+
+/* Free lists of the coroutine frames, by 64 bytes size classes. Larger
+ * frames go to the global operator new. */
+class framepool {
+ public:
+    static constexpr std::size_t granularity = 64;
+    static constexpr std::size_t classes = 64;
+
+    static void *
+    allocate(std::size_t size) {
+        std::size_t c = (size + granularity - 1) / granularity;
+        freeframe *f;
+
+        if (c >= classes) {
+            return ::operator new(size);
+        }
+
+        f = heads()[c];
+        if (f == nullptr) {
+            return ::operator new(c * granularity);
+        }
+
+        heads()[c] = f->next;
+        return f;
+    }
+
+    static void
+    deallocate(void *p, std::size_t size) noexcept {
+        std::size_t c = (size + granularity - 1) / granularity;
+        freeframe *f = static_cast<freeframe*>(p);
+
+        if (c >= classes) {
+            ::operator delete(p);
+            return;
+        }
+
+        f->next = heads()[c];
+        heads()[c] = f;
+    }
+
+    /* Give the cached frames back */
+    static void
+    trim() noexcept {
+        std::size_t c;
+        freeframe *f;
+
+        for (c = 0; c < classes; c++) {
+            while ((f = heads()[c])) {
+                heads()[c] = f->next;
+                ::operator delete(f);
+            }
+        }
+    }
+
+ private:
+    struct freeframe {
+        freeframe *next;
+    };
+
+    static freeframe **
+    heads() noexcept {
+        thread_local freeframe *heads[classes] = {};
+        return heads;
+    }
+};
+
+
+namespace detail {
+
+
+/* The C call frame of a spawned task, freed by the loop with free(3) */
+struct rootcall {
+    struct caio_basecall base;
+    std::coroutine_handle<> root;
+
+    /* The innermost suspended coroutine */
+    std::coroutine_handle<> resume;
+    bool started;
+    bool cancelled;
+
+    /* The invoker of the awaited C coroutine, see invokechild */
+    caio_invoker childinvoke;
+    bool childthrew;
+};
+
+
+static inline rootcall *
+current(struct caio_task *task) {
+    return reinterpret_cast<rootcall*>(task->current);
+}
+
+
+struct promisebase {
+    struct caio_task *task = nullptr;
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    static void *
+    operator new(std::size_t size) {
+        return framepool::allocate(size);
+    }
+
+    static void
+    operator delete(void *p, std::size_t size) noexcept {
+        framepool::deallocate(p, size);
+    }
+
+    std::suspend_always
+    initial_suspend() noexcept {
+        return {};
+    }
+
+    /* Back to the awaiting coroutine, or to the invoker for the root */
+    struct finalawaiter {
+        bool
+        await_ready() noexcept {
+            return false;
+        }
+
+        template <typename P>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<P> h) noexcept {
+            if (h.promise().continuation) {
+                return h.promise().continuation;
+            }
+
+            return std::noop_coroutine();
+        }
+
+        void
+        await_resume() noexcept {
+        }
+    };
+
+    finalawaiter
+    final_suspend() noexcept {
+        return {};
+    }
+
+    void
+    unhandled_exception() noexcept {
+        exception = std::current_exception();
+    }
+};
+
+
+template <typename T>
+struct promise: promisebase {
+    T value;
+
+    void
+    return_value(T v) {
+        value = std::move(v);
+    }
+
+    T
+    result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+
+        return std::move(value);
+    }
+};
+
+
+template <>
+struct promise<void>: promisebase {
+    void
+    return_void() noexcept {
+    }
+
+    void
+    result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+
+/* Base of the awaiters which park the caio task, resolves to zero or an
+ * errno. */
+struct suspension {
+    struct caio_task *task = nullptr;
+    int eno = 0;
+
+    bool
+    await_ready() noexcept {
+        return false;
+    }
+
+    int
+    await_resume() noexcept {
+        if (current(task)->cancelled) {
+            return ECANCELED;
+        }
+
+        return eno;
+    }
+
+ protected:
+    /* Throws caiopp::cancelled if the task is already killed, resuming it
+     * right away would spin within the same step. */
+    template <typename P>
+    void
+    park(std::coroutine_handle<P> h) {
+        task = h.promise().task;
+        if (current(task)->cancelled) {
+            throw cancelled();
+        }
+
+        current(task)->resume = h;
+    }
+};
+
+
+}  // namespace detail
+
+
+template <typename T = void>
+class [[nodiscard]] task {
+ public:
+    struct promise_type: detail::promise<T> {
+        task
+        get_return_object() noexcept {
+            return task(std::coroutine_handle<promise_type>::from_promise(
+                        *this));
+        }
+    };
+
+    task(task &&other) noexcept: handle(std::exchange(other.handle, {})) {
+    }
+
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool
+    await_ready() noexcept {
+        return false;
+    }
+
+    /* Runs the awaited task on the same caio task, right away */
+    template <typename P>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<P> parent) noexcept {
+        handle.promise().task = parent.promise().task;
+        handle.promise().continuation = parent;
+        return handle;
+    }
+
+    T
+    await_resume() {
+        return handle.promise().result();
+    }
+
+    std::coroutine_handle<promise_type>
+    release() noexcept {
+        return std::exchange(handle, {});
+    }
+
+ private:
+    explicit task(std::coroutine_handle<promise_type> h) noexcept:
+        handle(h) {
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+
+namespace detail {
+
+
+static inline void
+invoke(struct caio_task *task) {
+    rootcall *call = current(task);
+    auto root = std::coroutine_handle<caiopp::task<>::promise_type>::from_address(
+            call->root.address());
+
+    /* Killed before it's first step, nothing to unwind */
+    if ((task->status == CAIO_TERMINATING) && !call->started) {
+        root.destroy();
+        task->status = CAIO_TERMINATED;
+        return;
+    }
+
+    if (task->status == CAIO_TERMINATING) {
+        call->cancelled = true;
+    }
+
+    call->started = true;
+    task->status = CAIO_RUNNING;
+    root.promise().task = task;
+    call->resume.resume();
+    if (!root.done()) {
+        return;
+    }
+
+    /* There is no one to catch it, but caiopp::cancelled */
+    if (root.promise().exception) {
+        try {
+            std::rethrow_exception(root.promise().exception);
+        }
+        catch (const cancelled &) {
+        }
+        catch (...) {
+            std::terminate();
+        }
+    }
+
+    root.destroy();
+    task->status = CAIO_TERMINATED;
+}
+
+
+/* Stands in for the invoker of a C coroutine awaited by caiopp::call. The
+ * loop resumes the parent as if the C frame had returned when it is killed,
+ * so the kill is noted here for the root to unwind too. */
+static inline void
+invokechild(struct caio_task *task) {
+    rootcall *call = reinterpret_cast<rootcall*>(task->current->parent);
+
+    if ((task->status == CAIO_TERMINATING) && !call->childthrew) {
+        call->cancelled = true;
+    }
+
+    call->childinvoke(task);
+    if (task->status == CAIO_TERMINATING) {
+        call->childthrew = true;
+    }
+}
+
+
+}  // namespace detail
+
+
+/* Spawn the coroutine on a task of the pool, or queue it when the admission
+ * queue is enabled, see caio_admission. -1 with errno on failure. */
+static inline int
+spawn(struct caio *c, task<> &&t) {
+    struct caio_task *task;
+    detail::rootcall *call;
+
+    call = static_cast<detail::rootcall*>(
+            std::malloc(sizeof(detail::rootcall)));
+    if (call == nullptr) {
+        return -1;
+    }
+
+    call->base.parent = nullptr;
+    call->base.line = 0;
+    call->base.invoke = detail::invoke;
+    call->base.function = reinterpret_cast<const void*>(detail::invoke);
+    call->root = t.release();
+    call->resume = call->root;
+    call->started = false;
+    call->cancelled = false;
+    call->childinvoke = nullptr;
+    call->childthrew = false;
+
+    task = caio_task_new(c);
+    if (task == nullptr) {
+        if (caio_admission_full(c) ||
+                caio_task_enqueue(c, &call->base)) {
+            call->root.destroy();
+            std::free(call);
+            return -1;
+        }
+
+        return 0;
+    }
+
+    task->current = &call->base;
+    task->status = CAIO_RUNNING;
+#ifdef CAIO_STATS
+    caio_stats_frame(c);
+#endif
+    return 0;
+}
+
+
+/* The caio task running the coroutine, for the C APIs which need it, for
+ * example caio_timer_kill. */
+struct this_task {
+    struct caio_task *task = nullptr;
+
+    bool
+    await_ready() noexcept {
+        return false;
+    }
+
+    template <typename P>
+    bool
+    await_suspend(std::coroutine_handle<P> h) noexcept {
+        task = h.promise().task;
+        return false;
+    }
+
+    struct caio_task *
+    await_resume() noexcept {
+        return task;
+    }
+};
+
+
+/* Step the other tasks, resumes in the next loop iteration */
+struct yield: detail::suspension {
+    template <typename P>
+    void
+    await_suspend(std::coroutine_handle<P> h) {
+        park(h);
+        task->status = CAIO_RUNNING;
+    }
+};
+
+
+/* Await a C coroutine, like CAIO_AWAIT:
+ *
+ *     co_await caiopp::call(caio_nsleep_call_new, caio_nsleepA, &sleep, iom,
+ *             1000000ULL);
+ *
+ * Resolves to the errno it has thrown, if any, or ECANCELED when the task
+ * is killed meanwhile. */
+template <typename New, typename Coro, typename State, typename ...Args>
+struct call: detail::suspension {
+    New callnew;
+    Coro coro;
+    State *state;
+    std::tuple<Args...> args;
+
+    call(New n, Coro c, State *s, Args ...a): callnew(n), coro(c), state(s),
+        args(a...) {
+    }
+
+    template <typename P>
+    bool
+    await_suspend(std::coroutine_handle<P> h) {
+        detail::rootcall *root;
+
+        park(h);
+        root = detail::current(task);
+        task->eno = 0;
+        if (std::apply([this](Args ...a) {
+                    return callnew(task, coro, state, a...);
+                }, args)) {
+            eno = errno;
+            return false;
+        }
+
+        root->childinvoke = task->current->invoke;
+        root->childthrew = false;
+        task->current->invoke = detail::invokechild;
+        return true;
+    }
+
+    int
+    await_resume() noexcept {
+        if (detail::current(task)->cancelled) {
+            return ECANCELED;
+        }
+
+        if (eno == 0) {
+            eno = std::exchange(task->eno, 0);
+        }
+
+        return eno;
+    }
+};
+
+
+#ifdef CAIO_IOMODULES
+
+
+/* Wait for the events of the fd, like CAIO_FILE_AWAIT */
+struct file: detail::suspension {
+    struct caio_iomodule *iomodule;
+    int fd;
+    int events;
+
+    file(struct caio_iomodule *iom, int fd, int events): iomodule(iom),
+        fd(fd), events(events) {
+    }
+
+    template <typename P>
+    bool
+    await_suspend(std::coroutine_handle<P> h) {
+        park(h);
+        task->fd = fd;
+        task->events = events;
+        if (iomodule->monitor(iomodule, task, fd, events)) {
+            eno = errno? errno: EBADF;
+            return false;
+        }
+
+        task->status = CAIO_WAITING;
+        return true;
+    }
+
+    /* Killed while parked, the fd is still registered like the C
+     * coroutines which forget it in CAIO_FINALLY. */
+    int
+    await_resume() noexcept {
+        if (detail::current(task)->cancelled) {
+            CAIO_FILE_FORGET(iomodule, fd);
+            return ECANCELED;
+        }
+
+        return eno;
+    }
+};
+
+
+/* Like CAIO_NSLEEP */
+static inline auto
+sleep(caio_nsleep_t *s, struct caio_iomodule *iom,
+        unsigned long long nanoseconds) {
+    return call(caio_nsleep_call_new, caio_nsleepA, s, iom, nanoseconds);
+}
+
+
+/* read(2) and write(2) which await the fd while they would block, -1 with
+ * errno on failure. */
+static inline task<ssize_t>
+read(struct caio_iomodule *iom, int fd, void *buff, std::size_t size) {
+    ssize_t bytes;
+    int eno;
+
+    while (true) {
+        bytes = ::read(fd, buff, size);
+        if ((bytes != -1) || !IO_MUSTWAIT(errno)) {
+            co_return bytes;
+        }
+
+        eno = co_await file(iom, fd, CAIO_IN);
+        if (eno) {
+            errno = eno;
+            co_return -1;
+        }
+    }
+}
+
+
+static inline task<ssize_t>
+write(struct caio_iomodule *iom, int fd, const void *buff,
+        std::size_t size) {
+    ssize_t bytes;
+    int eno;
+
+    while (true) {
+        bytes = ::write(fd, buff, size);
+        if ((bytes != -1) || !IO_MUSTWAIT(errno)) {
+            co_return bytes;
+        }
+
+        eno = co_await file(iom, fd, CAIO_OUT);
+        if (eno) {
+            errno = eno;
+            co_return -1;
+        }
+    }
+}
+
+
+#endif  // CAIO_IOMODULES
+
+
+}  // namespace caiopp
+
+
+#endif  // CAIO_CAIO_HPP_
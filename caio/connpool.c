@@ -0,0 +1,570 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+
+#include "caio/connpool.h"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_conn
+#define CAIO_ARG1 struct caio_connpool *
+#define CAIO_ARG2 const struct sockaddr *
+#include "caio/generic.c"
+
+
+/* The reaper may close the idle connections up to an eighth of the idle
+ * timeout late, to share the buckets of the timers */
+#define REAPER_SLACK 8
+
+
+/* Park the task until a checkin wakes it up */
+#define PARK(task) \
+    do { \
+        (task)->current->line = __LINE__; \
+        (task)->fd = -1; \
+        (task)->events = 0; \
+        (task)->status = CAIO_WAITING; \
+        return; \
+        case __LINE__:; \
+    } while (0)
+
+
+struct caio_idleconn {
+    int fd;
+    unsigned long long since;
+};
+
+
+struct caio_connhost {
+    struct caio_connpool *pool;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+
+    /* Checked out or connecting */
+    size_t active;
+
+    /* Stack of the idle connections, the most recent on top */
+    struct caio_idleconn *idle;
+    size_t idlecount;
+
+    /* Closes the idle connections once they time out */
+    struct caio_timer reaper;
+
+    /* FIFO of the checkouts waiting for a checkin */
+    struct caio_conn *head;
+    struct caio_conn *tail;
+};
+
+
+struct caio_connpool {
+    struct caio *caio;
+    struct caio_iomodule *iomodule;
+    struct caio_timers *timers;
+    unsigned long long connecttimeout;
+    unsigned long long idletimeout;
+    size_t maxperhost;
+    size_t maxhosts;
+    size_t hostscount;
+    struct caio_connhost *hosts;
+    struct caio_idleconn *idle;
+    struct caio_connpoolstats stats;
+};
+
+
+static socklen_t
+_addrlen(const struct sockaddr *addr) {
+    switch (addr->sa_family) {
+        case AF_INET:
+            return sizeof(struct sockaddr_in);
+        case AF_INET6:
+            return sizeof(struct sockaddr_in6);
+        default:
+            return 0;
+    }
+}
+
+
+/* Field by field, the padding of the addresses might differ */
+static bool
+_addrequal(const struct sockaddr *a, const struct sockaddr *b) {
+    const struct sockaddr_in *a4 = (const struct sockaddr_in *)a;
+    const struct sockaddr_in *b4 = (const struct sockaddr_in *)b;
+    const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a;
+    const struct sockaddr_in6 *b6 = (const struct sockaddr_in6 *)b;
+
+    if (a->sa_family != b->sa_family) {
+        return false;
+    }
+
+    if (a->sa_family == AF_INET) {
+        return (a4->sin_port == b4->sin_port) &&
+            (a4->sin_addr.s_addr == b4->sin_addr.s_addr);
+    }
+
+    return (a6->sin6_port == b6->sin6_port) &&
+        (a6->sin6_scope_id == b6->sin6_scope_id) &&
+        (memcmp(&a6->sin6_addr, &b6->sin6_addr,
+                sizeof(struct in6_addr)) == 0);
+}
+
+
+static void
+_close(struct caio_connpool *pool, int fd) {
+    pool->iomodule->forget(pool->iomodule, fd);
+    close(fd);
+}
+
+
+/* Schedule the reaper for the oldest idle connection, at the bottom of the
+ * stack. The ones it misses, if the timers are full, are still checked
+ * when they are checked out. */
+static void
+_reaper(struct caio_connpool *pool, struct caio_connhost *host) {
+    unsigned long long age;
+
+    if ((pool->timers == NULL) || (pool->idletimeout == 0)) {
+        return;
+    }
+
+    if (host->idlecount == 0) {
+        caio_timer_stop(pool->timers, &host->reaper);
+        return;
+    }
+
+    age = caio_now(pool->caio) - host->idle[0].since;
+    caio_timer_start(pool->timers, &host->reaper,
+            (age < pool->idletimeout)? pool->idletimeout - age: 0,
+            pool->idletimeout / REAPER_SLACK);
+}
+
+
+static void
+_reap(struct caio_timer *t, void *arg) {
+    struct caio_connhost *host = arg;
+    struct caio_connpool *pool = host->pool;
+    unsigned long long now = caio_now(pool->caio);
+    size_t expired = 0;
+
+    while ((expired < host->idlecount) &&
+            ((now - host->idle[expired].since) >= pool->idletimeout)) {
+        pool->stats.stale++;
+        _close(pool, host->idle[expired++].fd);
+    }
+
+    host->idlecount -= expired;
+    memmove(host->idle, host->idle + expired,
+            host->idlecount * sizeof(struct caio_idleconn));
+    _reaper(pool, host);
+}
+
+
+static struct caio_connhost *
+_host(struct caio_connpool *pool, const struct sockaddr *addr) {
+    size_t i;
+    socklen_t addrlen = _addrlen(addr);
+    struct caio_connhost *host;
+
+    if (addrlen == 0) {
+        errno = EAFNOSUPPORT;
+        return NULL;
+    }
+
+    for (i = 0; i < pool->hostscount; i++) {
+        host = &pool->hosts[i];
+        if (_addrequal((struct sockaddr *)&host->addr, addr)) {
+            return host;
+        }
+    }
+
+    if (pool->hostscount == pool->maxhosts) {
+        errno = ENOSPC;
+        return NULL;
+    }
+
+    host = &pool->hosts[pool->hostscount];
+    host->pool = pool;
+    caio_timer_init(&host->reaper, _reap, host);
+    memcpy(&host->addr, addr, addrlen);
+    host->addrlen = addrlen;
+    host->idle = pool->idle + (pool->hostscount * pool->maxperhost);
+    pool->hostscount++;
+    return host;
+}
+
+
+/* Pop the most recent healthy idle connection, closing the stale ones */
+static int
+_idle(struct caio_connpool *pool, struct caio_connhost *host) {
+    char c;
+    ssize_t bytes;
+    struct caio_idleconn *ic;
+    unsigned long long now = caio_now(pool->caio);
+
+    while (host->idlecount) {
+        ic = &host->idle[--host->idlecount];
+        if (pool->idletimeout && ((now - ic->since) > pool->idletimeout)) {
+            pool->stats.stale++;
+            _close(pool, ic->fd);
+            continue;
+        }
+
+        /* Closed by the peer if readable, or out of sync */
+        bytes = recv(ic->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            pool->stats.reuses++;
+            if (host->idlecount == 0) {
+                _reaper(pool, host);
+            }
+            return ic->fd;
+        }
+
+        pool->stats.stale++;
+        _close(pool, ic->fd);
+    }
+
+    _reaper(pool, host);
+    return -1;
+}
+
+
+static void
+_enqueue(struct caio_connhost *host, struct caio_conn *conn) {
+    conn->next = NULL;
+    conn->queued = true;
+    if (host->tail) {
+        host->tail->next = conn;
+    }
+    else {
+        host->head = conn;
+    }
+    host->tail = conn;
+}
+
+
+static void
+_dequeue(struct caio_connhost *host, struct caio_conn *conn) {
+    struct caio_conn *prev = NULL;
+    struct caio_conn *c = host->head;
+
+    while (c && (c != conn)) {
+        prev = c;
+        c = c->next;
+    }
+
+    if (c == NULL) {
+        return;
+    }
+
+    if (prev) {
+        prev->next = conn->next;
+    }
+    else {
+        host->head = conn->next;
+    }
+
+    if (host->tail == conn) {
+        host->tail = prev;
+    }
+
+    conn->next = NULL;
+    conn->queued = false;
+}
+
+
+/* Hand the connection, or the slot of a closed one if fd is -1, over to the
+ * first waiter, false if there is none. The killed waiters are skipped,
+ * they leave the queue themselves. */
+static bool
+_handover(struct caio_connhost *host, int fd) {
+    struct caio_conn *conn;
+
+    while ((conn = host->head)) {
+        _dequeue(host, conn);
+        if (conn->task->status == CAIO_WAITING) {
+            conn->fd = fd;
+            conn->reused = fd != -1;
+            conn->active = true;
+            caio_task_wake(conn->task, CAIO_RUNNING);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/* Close the connection, if any, and give it's slot up */
+static void
+_release(struct caio_connpool *pool, struct caio_connhost *host, int fd) {
+    if (fd != -1) {
+        _close(pool, fd);
+    }
+
+    if (!_handover(host, -1)) {
+        host->active--;
+    }
+}
+
+
+ASYNC
+caio_connpool_checkoutA(struct caio_task *self, struct caio_conn *conn,
+        struct caio_connpool *pool, const struct sockaddr *addr) {
+    int err;
+    socklen_t errlen = sizeof(err);
+    CAIO_BEGIN(self);
+
+    conn->fd = -1;
+    conn->reused = false;
+    conn->pool = pool;
+    conn->task = self;
+    conn->next = NULL;
+    conn->queued = false;
+    conn->active = false;
+    conn->done = false;
+    caio_timer_init(&conn->timer, caio_timer_kill, self);
+
+    conn->host = _host(pool, addr);
+    if (conn->host == NULL) {
+        CAIO_THROW(self, errno);
+    }
+
+    if (pool->timers && pool->connecttimeout &&
+            caio_timer_start(pool->timers, &conn->timer,
+                pool->connecttimeout, 0)) {
+        CAIO_THROW(self, errno);
+    }
+
+    /* The waiters are served first, in order */
+    if (conn->host->head == NULL) {
+        conn->fd = _idle(pool, conn->host);
+        if (conn->fd != -1) {
+            conn->reused = true;
+            conn->active = true;
+            conn->done = true;
+            conn->host->active++;
+            CAIO_RETURN(self);
+        }
+    }
+
+    if ((conn->host->head == NULL) &&
+            (conn->host->active < pool->maxperhost)) {
+        conn->active = true;
+        conn->host->active++;
+    }
+    else {
+        pool->stats.waits++;
+        _enqueue(conn->host, conn);
+        PARK(self);
+
+        /* Handed over by a checkin, a connection or the slot of one */
+        if (conn->fd != -1) {
+            pool->stats.reuses++;
+            conn->done = true;
+            CAIO_RETURN(self);
+        }
+    }
+
+    conn->fd = socket(addr->sa_family,
+            SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->fd == -1) {
+        CAIO_THROW(self, errno);
+    }
+
+    pool->stats.connects++;
+    if (connect(conn->fd, addr, conn->host->addrlen) == 0) {
+        conn->done = true;
+        CAIO_RETURN(self);
+    }
+
+    if (errno != EINPROGRESS) {
+        CAIO_THROW(self, errno);
+    }
+
+    CAIO_FILE_AWAIT(pool->iomodule, self, conn->fd, CAIO_OUT);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &errlen)) {
+        CAIO_THROW(self, errno);
+    }
+
+    if (err) {
+        CAIO_THROW(self, err);
+    }
+
+    conn->done = true;
+    CAIO_FINALLY(self);
+    if (pool->timers) {
+        caio_timer_stop(pool->timers, &conn->timer);
+    }
+
+    if (conn->queued) {
+        _dequeue(conn->host, conn);
+    }
+
+    /* Killed while waiting or connecting */
+    if (!CAIO_HASERROR(self) && !conn->done) {
+        self->eno = ECANCELED;
+    }
+
+    /* Handed over to a waiter killed before it's step, pass it on */
+    if (CAIO_HASERROR(self) && conn->active && conn->reused) {
+        caio_connpool_checkin(conn, true);
+    }
+    else if (CAIO_HASERROR(self) && conn->active) {
+        _release(pool, conn->host, conn->fd);
+        conn->fd = -1;
+        conn->active = false;
+    }
+}
+
+
+int
+caio_connpool_checkin(struct caio_conn *conn, bool reusable) {
+    struct caio_connhost *host;
+    struct caio_connpool *pool;
+    struct caio_idleconn *ic;
+
+    if ((conn == NULL) || (conn->fd == -1) || (conn->host == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    host = conn->host;
+    pool = conn->pool;
+    if (!reusable || (host->idlecount == pool->maxperhost)) {
+        _release(pool, host, conn->fd);
+        conn->fd = -1;
+        conn->active = false;
+        return 0;
+    }
+
+    conn->active = false;
+    if (_handover(host, conn->fd)) {
+        conn->fd = -1;
+        return 0;
+    }
+
+    ic = &host->idle[host->idlecount++];
+    ic->fd = conn->fd;
+    ic->since = caio_now(pool->caio);
+    host->active--;
+    conn->fd = -1;
+    if (host->idlecount == 1) {
+        _reaper(pool, host);
+    }
+    return 0;
+}
+
+
+int
+caio_connpool_timeouts(struct caio_connpool *pool,
+        unsigned long long connect_ns, unsigned long long idle_ns) {
+    if (pool == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (connect_ns && (pool->timers == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pool->connecttimeout = connect_ns;
+    pool->idletimeout = idle_ns;
+    return 0;
+}
+
+
+void
+caio_connpool_stats(struct caio_connpool *pool,
+        struct caio_connpoolstats *stats) {
+    *stats = pool->stats;
+}
+
+
+struct caio_connpool *
+caio_connpool_create(struct caio *c, struct caio_iomodule *iom,
+        struct caio_timers *timers, size_t maxhosts, size_t maxperhost) {
+    struct caio_connpool *pool;
+
+    if ((c == NULL) || (iom == NULL) || (maxhosts == 0) ||
+            (maxperhost == 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pool = malloc(sizeof(struct caio_connpool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(struct caio_connpool));
+
+    pool->hosts = calloc(maxhosts, sizeof(struct caio_connhost));
+    if (pool->hosts == NULL) {
+        goto failed;
+    }
+
+    pool->idle = calloc(maxhosts * maxperhost, sizeof(struct caio_idleconn));
+    if (pool->idle == NULL) {
+        goto failed;
+    }
+
+    pool->caio = c;
+    pool->iomodule = iom;
+    pool->timers = timers;
+    pool->maxhosts = maxhosts;
+    pool->maxperhost = maxperhost;
+    return pool;
+
+failed:
+    free(pool->hosts);
+    free(pool);
+    return NULL;
+}
+
+
+int
+caio_connpool_destroy(struct caio_connpool *pool) {
+    size_t i;
+    struct caio_connhost *host;
+
+    if (pool == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < pool->hostscount; i++) {
+        host = &pool->hosts[i];
+        if (pool->timers) {
+            caio_timer_stop(pool->timers, &host->reaper);
+        }
+
+        while (host->idlecount) {
+            _close(pool, host->idle[--host->idlecount].fd);
+        }
+    }
+
+    free(pool->idle);
+    free(pool->hosts);
+    free(pool);
+    return 0;
+}
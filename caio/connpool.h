@@ -0,0 +1,130 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_CONNPOOL_H_
+#define CAIO_CONNPOOL_H_
+
+
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#include "caio/caio.h"
+#include "caio/timer.h"
+
+
+/* Outbound TCP connections kept alive and reused, keyed by the peer's
+ * address, IPv4 or IPv6. At most maxperhost connections are open to each
+ * peer, checkouts beyond that wait in order, the checkins hand their
+ * connections over to them directly. The idle connections are health
+ * checked when they are checked out: the ones closed or written by the peer
+ * meanwhile are closed instead of reused. The ones idle for longer than the
+ * idle timeout are closed by a timer, or when they are checked out if there
+ * are no timers. */
+struct caio_connpool;
+struct caio_connhost;
+
+
+struct caio_connpoolstats {
+    unsigned long connects;
+    unsigned long reuses;
+
+    /* Idle connections closed by the health check or the idle timeout */
+    unsigned long stale;
+
+    /* Checkouts which had to wait for a checkin */
+    unsigned long waits;
+};
+
+
+/* A checkout, fd is the connected, non-blocking socket, ready to use with
+ * CAIO_FILE_AWAIT until it's checked in. reused tells if it was an idle
+ * one. */
+typedef struct caio_conn {
+    int fd;
+    bool reused;
+
+    /* Private */
+    struct caio_connpool *pool;
+    struct caio_connhost *host;
+    struct caio_task *task;
+    struct caio_conn *next;
+    bool queued;
+
+    /* Holds one of the maxperhost connections of the host */
+    bool active;
+    bool done;
+    struct caio_timer timer;
+} caio_conn_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_conn
+#define CAIO_ARG1 struct caio_connpool *
+#define CAIO_ARG2 const struct sockaddr *
+#include "caio/generic.h"
+
+
+/* timers is only required for the timeouts, see caio_connpool_timeouts. It
+ * must have room for a timer per host and per pending checkout, and outlive
+ * the pool. */
+struct caio_connpool *
+caio_connpool_create(struct caio *c, struct caio_iomodule *iom,
+        struct caio_timers *timers, size_t maxhosts, size_t maxperhost);
+
+
+int
+caio_connpool_destroy(struct caio_connpool *pool);
+
+
+/* The connect timeout covers the wait for a free connection as well, the
+ * checkout fails with ETIMEDOUT then. Zero disables either of them. Like any
+ * other timer, the idle timeout keeps the loop running while there are idle
+ * connections. */
+int
+caio_connpool_timeouts(struct caio_connpool *pool,
+        unsigned long long connect_ns, unsigned long long idle_ns);
+
+
+/* Give the connection back. Check in as reusable only the connections
+ * which are not awaited anymore and have no pending data, close them
+ * otherwise, for example after an error. */
+int
+caio_connpool_checkin(struct caio_conn *conn, bool reusable);
+
+
+void
+caio_connpool_stats(struct caio_connpool *pool,
+        struct caio_connpoolstats *stats);
+
+
+ASYNC
+caio_connpool_checkoutA(struct caio_task *self, struct caio_conn *conn,
+        struct caio_connpool *pool, const struct sockaddr *addr);
+
+
+/* The addr must remain valid until the checkout is done. A checkout killed
+ * while waiting or connecting fails with ECANCELED, unless the kill sets an
+ * errno, see caio_timer_kill. */
+#define CAIO_CONNPOOL_CHECKOUT(self, conn, pool, addr) \
+    CAIO_AWAIT(self, caio_conn, caio_connpool_checkoutA, conn, pool, \
+            (const struct sockaddr*)(addr))
+
+
+#endif  // CAIO_CONNPOOL_H_
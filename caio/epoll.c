@@ -18,35 +18,101 @@
  */
 #include <sys/epoll.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 
 #include "caio/epoll.h"
+#include "caio/trace.h"
+#include "caio/probes.h"
+
+#ifdef CAIO_STATS
+#include "caio/stats.h"
+#endif
 
 
 struct caio_epoll {
     struct caio_iomodule;
     int fd;
-    int timeout_ms;
+    unsigned long long timeout_ns;
+#ifdef CAIO_EPOLL_PWAIT2
+    bool pwait2;
+#endif
     size_t maxevents;
     size_t waitingfiles;
+    size_t watchers;
     struct epoll_event *events;
+
+    /* The task of each armed registration, indexed by the fd, so the ones
+     * forgotten before they fire, by killed tasks, are accounted for. */
+    struct caio_task **files;
+    size_t filessize;
 };
 
 
+/* Watchers are at least word aligned, so the lowest bit of the event's data
+ * tells them apart from the fds of the tasks, which are shifted by one. */
+#define WATCHER 0x1ULL
+
+
+/* Polls without blocking when a task is runnable, and never blocks longer
+ * than caio_loop_once allows. */
+static inline int
+_wait(struct caio_epoll *e, struct caio* c) {
+    unsigned long long timeout_ns = caio_waitlimit(c);
+
+    if (timeout_ns > e->timeout_ns) {
+        timeout_ns = e->timeout_ns;
+    }
+
+#ifdef CAIO_EPOLL_PWAIT2
+    struct timespec timeout;
+    int nfds;
+
+    if (e->pwait2) {
+        timeout.tv_sec = timeout_ns / 1000000000ULL;
+        timeout.tv_nsec = timeout_ns % 1000000000ULL;
+        nfds = epoll_pwait2(e->fd, e->events, e->maxevents, &timeout, NULL);
+        if ((nfds != -1) || (errno != ENOSYS)) {
+            return nfds;
+        }
+
+        /* Kernels older than 5.11 */
+        e->pwait2 = false;
+    }
+#endif
+
+    /* Rounded up, so it never wakes up earlier than asked */
+    return epoll_wait(e->fd, e->events, e->maxevents,
+            (timeout_ns + 999999) / 1000000);
+}
+
+
 static int
 _tick(struct caio_epoll *e, struct caio* c) {
     int i;
+    int fd;
     int nfds;
+    int events;
     struct caio_task *task;
+    struct caio_watcher *watcher;
 
-    if (e->waitingfiles == 0) {
+    if ((e->waitingfiles == 0) && (e->watchers == 0)) {
         return 0;
     }
 
     errno = 0;
-    nfds = epoll_wait(e->fd, e->events, e->maxevents, e->timeout_ms);
+    CAIO_PROBE2(wait_begin, e, e->waitingfiles);
+#ifdef CAIO_STATS
+    unsigned long long ts = caio_stats_clock();
+    nfds = _wait(e, c);
+    e->iostats.waitns += caio_stats_clock() - ts;
+    e->iostats.waits++;
+#else
+    nfds = _wait(e, c);
+#endif
+    CAIO_PROBE2(wait_end, e, nfds);
     if (nfds < 0) {
         return -1;
     }
@@ -56,13 +122,63 @@ _tick(struct caio_epoll *e, struct caio* c) {
     }
 
     for (i = 0; i < nfds; i++) {
-        task = (struct caio_task*)e->events[i].data.ptr;
-        if (task->status == CAIO_WAITING) {
-            task->status = CAIO_RUNNING;
-            e->waitingfiles--;
+        if (e->events[i].data.u64 & WATCHER) {
+            watcher = (struct caio_watcher*)(uintptr_t)
+                (e->events[i].data.u64 & ~WATCHER);
+            if (!watcher->active) {
+                continue;
+            }
+
+            events = e->events[i].events & (CAIO_IN | CAIO_OUT | CAIO_ERR);
+            if (e->events[i].events & (EPOLLERR | EPOLLHUP)) {
+                events |= CAIO_ERR;
+            }
+            watcher->callback(watcher, events);
+            continue;
+        }
+
+        fd = e->events[i].data.u64 >> 1;
+        task = e->files[fd];
+        if (task == NULL) {
+            continue;
         }
+
+        e->files[fd] = NULL;
+        e->waitingfiles--;
+
+        /* Unless it's killed and awaits something else meanwhile */
+        if ((task->status == CAIO_WAITING) && (task->fd == fd)) {
+            CAIO_TRACE_EVENT(WAKE, task, -1, 0);
+            caio_task_wake(task, CAIO_RUNNING);
+        }
+    }
+
+#ifdef CAIO_STATS
+    e->iostats.events += nfds;
+    e->iostats.waitingfiles = e->waitingfiles;
+#endif
+    return 0;
+}
+
+
+static int
+_files(struct caio_epoll *e, int fd) {
+    size_t size = e->filessize? e->filessize: 64;
+    struct caio_task **files;
+
+    while (size <= (size_t)fd) {
+        size *= 2;
     }
 
+    files = realloc(e->files, size * sizeof(struct caio_task *));
+    if (files == NULL) {
+        return -1;
+    }
+
+    memset(files + e->filessize, 0,
+            (size - e->filessize) * sizeof(struct caio_task *));
+    e->files = files;
+    e->filessize = size;
     return 0;
 }
 
@@ -72,28 +188,121 @@ _monitor(struct caio_epoll *e, struct caio_task *task, int fd,
         int events) {
     struct epoll_event ee;
 
+    CAIO_TRACE_EVENT(AWAIT, task, fd, events);
+    CAIO_PROBE3(file_await, task, fd, events);
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (((size_t)fd >= e->filessize) && _files(e, fd)) {
+        return -1;
+    }
+
     ee.events = events | EPOLLONESHOT;
-    ee.data.ptr = task;
+    ee.data.u64 = (uint64_t)fd << 1;
+#ifdef CAIO_STATS
+    e->iostats.ctls++;
+#endif
     if (epoll_ctl(e->fd, EPOLL_CTL_MOD, fd, &ee)) {
+#ifdef CAIO_STATS
+        e->iostats.ctls++;
+#endif
         if (epoll_ctl(e->fd, EPOLL_CTL_ADD, fd, &ee)) {
             return -1;
         }
         errno = 0;
     }
 
-    e->waitingfiles++;
+    if (e->files[fd] == NULL) {
+        e->waitingfiles++;
+    }
+    e->files[fd] = task;
+#ifdef CAIO_STATS
+    e->iostats.waitingfiles = e->waitingfiles;
+#endif
+    return 0;
+}
+
+
+static int
+_watch(struct caio_epoll *e, struct caio_watcher *w) {
+    struct epoll_event ee;
+
+#ifdef CAIO_STATS
+    e->iostats.ctls++;
+#endif
+    if (w->events == 0) {
+        if (!w->active) {
+            return 0;
+        }
+
+        w->active = false;
+        e->watchers--;
+        return epoll_ctl(e->fd, EPOLL_CTL_DEL, w->fd, NULL);
+    }
+
+    ee.events = w->events;
+    ee.data.u64 = (uintptr_t)w | WATCHER;
+    if (epoll_ctl(e->fd, EPOLL_CTL_MOD, w->fd, &ee)) {
+#ifdef CAIO_STATS
+        e->iostats.ctls++;
+#endif
+        if (epoll_ctl(e->fd, EPOLL_CTL_ADD, w->fd, &ee)) {
+            return -1;
+        }
+        errno = 0;
+    }
+
+    if (!w->active) {
+        w->active = true;
+        e->watchers++;
+    }
     return 0;
 }
 
 
+static int
+_pollable(struct caio_epoll *e) {
+    return e->fd;
+}
+
+
 static int
 _forget(struct caio_epoll *e, int fd) {
+    CAIO_PROBE1(file_forget, fd);
+#ifdef CAIO_STATS
+    e->iostats.ctls++;
+#endif
+    if ((fd >= 0) && ((size_t)fd < e->filessize) && e->files[fd]) {
+        e->files[fd] = NULL;
+        e->waitingfiles--;
+#ifdef CAIO_STATS
+        e->iostats.waitingfiles = e->waitingfiles;
+#endif
+    }
+
     if (epoll_ctl(e->fd, EPOLL_CTL_DEL, fd, NULL)) {
         return -1;
     }
 
     return 0;
 }
+int
+caio_epoll_timeout(struct caio_epoll *e, unsigned long long timeout_ns) {
+    if (e == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    e->timeout_ns = timeout_ns;
+#ifdef CAIO_EPOLL_PWAIT2
+    e->pwait2 = true;
+#endif
+    return 0;
+}
+
+
 struct caio_epoll *
 caio_epoll_create(struct caio* c, size_t maxevents, unsigned int timeout_ms) {
     struct caio_epoll *e;
@@ -109,7 +318,7 @@ caio_epoll_create(struct caio* c, size_t maxevents, unsigned int timeout_ms) {
     }
     memset(e, 0, sizeof(struct caio_epoll));
 
-    e->timeout_ms = timeout_ms;
+    caio_epoll_timeout(e, timeout_ms * 1000000ULL);
     e->waitingfiles = 0;
     e->maxevents = maxevents;
     e->fd = epoll_create1(0);
@@ -125,6 +334,8 @@ caio_epoll_create(struct caio* c, size_t maxevents, unsigned int timeout_ms) {
     e->tick = (caio_hook) _tick;
     e->monitor = (caio_filemonitor)_monitor;
     e->forget = (caio_fileforget)_forget;
+    e->pollable = (caio_pollable)_pollable;
+    e->watch = (caio_filewatch)_watch;
 
     if (caio_module_install(c, (struct caio_module*)e)) {
         goto failed;
@@ -160,6 +371,7 @@ caio_epoll_destroy(struct caio* c, struct caio_epoll *e) {
         free(e->events);
     }
 
+    free(e->files);
     free(e);
     return 0;
 }
@@ -36,4 +36,9 @@ int
 caio_epoll_destroy(struct caio* c, struct caio_epoll *e);
 
 
+/* Nanosecond resolution with epoll_pwait2(2), milliseconds otherwise. */
+int
+caio_epoll_timeout(struct caio_epoll *e, unsigned long long timeout_ns);
+
+
 #endif  // CAIO_EPOLL_H_
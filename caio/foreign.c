@@ -0,0 +1,165 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "caio/foreign.h"
+
+
+struct caio_foreignwatch {
+    struct caio_watcher;
+    caio_foreign_io io;
+    void *arg;
+};
+
+
+struct caio_foreign {
+    struct caio_iomodule *iomodule;
+    struct caio_timers *timers;
+
+    /* The timer */
+    struct caio_timer timer;
+    caio_foreign_timeout timeout;
+    void *timeoutarg;
+
+    /* Indexed by the fd, so a watcher's memory is never reused by another
+     * file while an event for it might still be pending. */
+    int maxfileno;
+    struct caio_foreignwatch *watches;
+};
+
+
+static void
+_ready(struct caio_watcher *w, int events) {
+    struct caio_foreignwatch *fw = (struct caio_foreignwatch*)w;
+
+    fw->io(w->fd, events, fw->arg);
+}
+
+
+static void
+_expired(struct caio_timer *t, void *arg) {
+    struct caio_foreign *f = arg;
+
+    f->timeout(f->timeoutarg);
+}
+
+
+int
+caio_foreign_watch(struct caio_foreign *f, int fd, int events,
+        caio_foreign_io callback, void *arg) {
+    struct caio_foreignwatch *fw;
+
+    if ((f == NULL) || (fd < 0) || (fd > f->maxfileno) ||
+            (events && (callback == NULL))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fw = &f->watches[fd];
+    fw->fd = fd;
+    fw->events = events & (CAIO_IN | CAIO_OUT);
+    fw->io = callback;
+    fw->arg = arg;
+    return f->iomodule->watch(f->iomodule, (struct caio_watcher*)fw);
+}
+
+
+int
+caio_foreign_timer(struct caio_foreign *f, long long timeout_ns,
+        caio_foreign_timeout callback, void *arg) {
+    if ((f == NULL) || ((timeout_ns >= 0) && (callback == NULL))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (timeout_ns < 0) {
+        return caio_timer_stop(f->timers, &f->timer);
+    }
+
+    f->timeout = callback;
+    f->timeoutarg = arg;
+    return caio_timer_start(f->timers, &f->timer, timeout_ns, 0);
+}
+
+
+struct caio_foreign *
+caio_foreign_create(struct caio *c, struct caio_iomodule *iom,
+        struct caio_timers *timers, int maxfileno) {
+    int i;
+    struct caio_foreign *f;
+
+    if ((c == NULL) || (iom == NULL) || (timers == NULL) ||
+            (maxfileno <= 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    if (iom->watch == NULL) {
+        errno = ENOTSUP;
+        return NULL;
+    }
+
+    f = malloc(sizeof(struct caio_foreign));
+    if (f == NULL) {
+        return NULL;
+    }
+    memset(f, 0, sizeof(struct caio_foreign));
+
+    f->watches = calloc(maxfileno + 1, sizeof(struct caio_foreignwatch));
+    if (f->watches == NULL) {
+        free(f);
+        return NULL;
+    }
+
+    for (i = 0; i <= maxfileno; i++) {
+        f->watches[i].callback = _ready;
+    }
+
+    f->iomodule = iom;
+    f->timers = timers;
+    f->maxfileno = maxfileno;
+    caio_timer_init(&f->timer, _expired, f);
+    return f;
+}
+
+
+int
+caio_foreign_destroy(struct caio_foreign *f) {
+    int i;
+    struct caio_foreignwatch *fw;
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    caio_timer_stop(f->timers, &f->timer);
+    for (i = 0; i <= f->maxfileno; i++) {
+        fw = &f->watches[i];
+        if (fw->active) {
+            fw->events = 0;
+            f->iomodule->watch(f->iomodule, (struct caio_watcher*)fw);
+        }
+    }
+
+    free(f->watches);
+    free(f);
+    return 0;
+}
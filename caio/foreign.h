@@ -0,0 +1,65 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_FOREIGN_H_
+#define CAIO_FOREIGN_H_
+
+
+#include <stddef.h>
+
+#include "caio/caio.h"
+#include "caio/timer.h"
+
+
+/* Hosts the third-party async libraries, such as libcurl's multi
+ * interface, c-ares or nghttp2, which ask their host to watch files and to
+ * set a single timer through callbacks. Their files are watched by the
+ * iomodule itself, and their timer is one of the timers facility, so they
+ * share the loop's single wait without any extra thread or wakeup.
+ *
+ * The iomodule must support the watchers, like epoll(7). */
+struct caio_foreign;
+typedef void (*caio_foreign_io) (int fd, int events, void *arg);
+typedef void (*caio_foreign_timeout) (void *arg);
+
+
+struct caio_foreign *
+caio_foreign_create(struct caio *c, struct caio_iomodule *iom,
+        struct caio_timers *timers, int maxfileno);
+
+
+int
+caio_foreign_destroy(struct caio_foreign *f);
+
+
+/* Call the callback whenever any of the events (CAIO_IN, CAIO_OUT) is
+ * ready on the fd, until it's watched with zero events. Level-triggered,
+ * the callbacks are called with the ready events, CAIO_ERR on error or
+ * hangup. */
+int
+caio_foreign_watch(struct caio_foreign *f, int fd, int events,
+        caio_foreign_io callback, void *arg);
+
+
+/* The single timer, a negative timeout cancels it. */
+int
+caio_foreign_timer(struct caio_foreign *f, long long timeout_ns,
+        caio_foreign_timeout callback, void *arg);
+
+
+#endif  // CAIO_FOREIGN_H_
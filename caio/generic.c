@@ -59,9 +59,13 @@ CAIO_NAME(call_new)(struct caio_task *task, CAIO_NAME(coro) coro,
     call->state = state;
     call->line = 0;
     call->invoke = CAIO_NAME(invoker);
+    call->function = coro;
 
     task->status = CAIO_RUNNING;
     task->current = (struct caio_basecall*) call;
+#ifdef CAIO_STATS
+    caio_stats_frame(task->caio);
+#endif
 
     /* arguments */
 #ifdef CAIO_ARG1
@@ -86,10 +90,32 @@ CAIO_NAME(spawn) (struct caio *c, CAIO_NAME(coro) coro, CAIO_NAME(t) *state
     struct caio_task *task = NULL;
 
     task = caio_task_new(c);
-    if (task == NULL) {
+    if ((task == NULL) && caio_admission_full(c)) {
         return -1;
     }
 
+    /* No idle task, build the call on a placeholder and queue it */
+    if (task == NULL) {
+        struct caio_task pending = {.caio = c, .current = NULL};
+        if (CAIO_NAME(call_new)(&pending, coro, state
+#ifdef CAIO_ARG1
+            , arg1
+    #ifdef CAIO_ARG2
+                , arg2
+    #endif  // CAIO_ARG2
+#endif  // CAIO_ARG1
+            )) {  // NOLINT
+            return -1;
+        }
+
+        if (caio_task_enqueue(c, pending.current)) {
+            free(pending.current);
+            return -1;
+        }
+
+        return 0;
+    }
+
     if (CAIO_NAME(call_new)(task, coro, state
 #ifdef CAIO_ARG1
         , arg1
@@ -0,0 +1,100 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <string.h>
+
+#include "caio/hist.h"
+
+
+void
+caio_hist_reset(struct caio_hist *h) {
+    memset(h, 0, sizeof(struct caio_hist));
+}
+
+
+void
+caio_hist_decay(struct caio_hist *h) {
+    int i;
+    unsigned long count = 0;
+
+    for (i = 0; i < CAIO_HIST_BUCKETS; i++) {
+        h->buckets[i] >>= 1;
+        count += h->buckets[i];
+    }
+
+    h->count = count;
+    h->sum >>= 1;
+    h->max = 0;
+}
+
+
+void
+caio_hist_merge(struct caio_hist *h, const struct caio_hist *other) {
+    int i;
+
+    for (i = 0; i < CAIO_HIST_BUCKETS; i++) {
+        h->buckets[i] += other->buckets[i];
+    }
+
+    h->count += other->count;
+    h->sum += other->sum;
+    if (other->max > h->max) {
+        h->max = other->max;
+    }
+}
+
+
+unsigned long long
+caio_hist_bucketvalue(unsigned int bucket) {
+    int msb;
+
+    if (bucket < CAIO_HIST_SUBBUCKETS) {
+        return bucket;
+    }
+
+    msb = (bucket >> CAIO_HIST_SUBBITS) + CAIO_HIST_SUBBITS - 1;
+    return (1ULL << msb) |
+        ((unsigned long long)(bucket & (CAIO_HIST_SUBBUCKETS - 1)) <<
+         (msb - CAIO_HIST_SUBBITS));
+}
+
+
+unsigned long long
+caio_hist_percentile(const struct caio_hist *h, double percentile) {
+    int i;
+    unsigned long rank;
+    unsigned long seen = 0;
+
+    if (h->count == 0) {
+        return 0;
+    }
+
+    rank = (unsigned long)(h->count * percentile / 100.0);
+    if (rank >= h->count) {
+        rank = h->count - 1;
+    }
+
+    for (i = 0; i < CAIO_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank) {
+            return caio_hist_bucketvalue(i);
+        }
+    }
+
+    return h->max;
+}
@@ -0,0 +1,91 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_HIST_H_
+#define CAIO_HIST_H_
+
+
+#include <stddef.h>
+
+
+/* Log-linear histogram: each power of two is divided into
+ * 2^CAIO_HIST_SUBBITS linear buckets, so the relative error of any
+ * reported value is less than 2^-CAIO_HIST_SUBBITS. */
+#define CAIO_HIST_SUBBITS 3
+#define CAIO_HIST_SUBBUCKETS (1 << CAIO_HIST_SUBBITS)
+#define CAIO_HIST_BUCKETS (64 * CAIO_HIST_SUBBUCKETS)
+
+
+struct caio_hist {
+    unsigned long count;
+    unsigned long long sum;
+    unsigned long long max;
+    unsigned long buckets[CAIO_HIST_BUCKETS];
+};
+
+
+static inline unsigned int
+caio_hist_bucket(unsigned long long value) {
+    int msb;
+
+    if (value < CAIO_HIST_SUBBUCKETS) {
+        return value;
+    }
+
+    msb = 63 - __builtin_clzll(value);
+    return ((msb - CAIO_HIST_SUBBITS + 1) << CAIO_HIST_SUBBITS) +
+        ((value >> (msb - CAIO_HIST_SUBBITS)) & (CAIO_HIST_SUBBUCKETS - 1));
+}
+
+
+static inline void
+caio_hist_add(struct caio_hist *h, unsigned long long value) {
+    h->buckets[caio_hist_bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+
+void
+caio_hist_reset(struct caio_hist *h);
+
+
+/* Halve all the buckets, calling this periodically turns the histogram
+ * into a moving (exponentially decaying) one. */
+void
+caio_hist_decay(struct caio_hist *h);
+
+
+void
+caio_hist_merge(struct caio_hist *h, const struct caio_hist *other);
+
+
+/* The lowest value which falls into the given bucket */
+unsigned long long
+caio_hist_bucketvalue(unsigned int bucket);
+
+
+/* Percentile is between 0 and 100, returns 0 for an empty histogram. */
+unsigned long long
+caio_hist_percentile(const struct caio_hist *h, double percentile);
+
+
+#endif  // CAIO_HIST_H_
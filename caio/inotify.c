@@ -0,0 +1,548 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+#include "caio/caio.h"
+#include "caio/inotify.h"
+
+
+/* Events which will be delivered regardless of the waiter's mask */
+#define INOTIFY_ALWAYS (IN_IGNORED | IN_Q_OVERFLOW | IN_UNMOUNT)
+#define INOTIFY_BUFFSIZE 4096
+
+
+/* A watcher belongs to a task and a path, and lives until the task forgets
+ * it, so events arriving while the task is not awaiting are kept as
+ * pending and delivered by the next await. */
+struct caio_inotify_watcher {
+    int wd;
+    uint32_t mask;
+    char *path;
+    bool waiting;
+    bool fired;
+    struct caio_task *task;
+    struct caio_inotify_event *event;
+    struct caio_inotify_event pending;
+
+    /* Next watcher in the same wd table bucket, or in the free list */
+    struct caio_inotify_watcher *next;
+
+    /* Next watcher to wake up at the end of the batch */
+    struct caio_inotify_watcher *nextfired;
+};
+
+
+typedef struct caio_inotify {
+    int fd;
+    struct caio *caio;
+    struct caio_iomodule *iomodule;
+    struct caio_task *dispatcher;
+    struct caio_inotify_watcher *watchers;
+    struct caio_inotify_watcher *free;
+    size_t maxwatchers;
+    size_t waiters;
+
+    /* Watch descriptor to watchers hash table */
+    struct caio_inotify_watcher **table;
+    size_t tablemask;
+    struct caio_inotify_watcher *fired;
+} caio_inotify_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_inotify
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static inline struct caio_inotify_watcher **
+_bucket(struct caio_inotify *n, int wd) {
+    return &n->table[wd & n->tablemask];
+}
+
+
+static void
+_link(struct caio_inotify *n, struct caio_inotify_watcher *w) {
+    struct caio_inotify_watcher **bucket = _bucket(n, w->wd);
+
+    w->next = *bucket;
+    *bucket = w;
+}
+
+
+static void
+_unlink(struct caio_inotify *n, struct caio_inotify_watcher *w) {
+    struct caio_inotify_watcher **ptr = _bucket(n, w->wd);
+
+    while (*ptr) {
+        if (*ptr == w) {
+            *ptr = w->next;
+            break;
+        }
+        ptr = &(*ptr)->next;
+    }
+
+    w->next = NULL;
+    w->wd = -1;
+}
+
+
+/* Drops the watcher's kernel watch, or narrows it down to the masks of the
+ * other watchers of the same watch descriptor. */
+static void
+_unwatch(struct caio_inotify *n, struct caio_inotify_watcher *w) {
+    int wd = w->wd;
+    int newwd;
+    uint32_t mask = 0;
+    struct caio_inotify_watcher *other = NULL;
+    struct caio_inotify_watcher *o;
+
+    if (wd == -1) {
+        return;
+    }
+
+    _unlink(n, w);
+    for (o = *_bucket(n, wd); o; o = o->next) {
+        if (o->wd == wd) {
+            mask |= o->mask;
+            other = o;
+        }
+    }
+
+    if (other == NULL) {
+        inotify_rm_watch(n->fd, wd);
+        return;
+    }
+
+    /* The path may refer to another inode by now */
+    newwd = inotify_add_watch(n->fd, other->path, mask);
+    if ((newwd != -1) && (newwd != wd)) {
+        inotify_rm_watch(n->fd, newwd);
+    }
+}
+
+
+static void
+_release(struct caio_inotify *n, struct caio_inotify_watcher *w) {
+    _unwatch(n, w);
+    if (w->waiting) {
+        n->waiters--;
+    }
+
+    free(w->path);
+    memset(w, 0, sizeof(struct caio_inotify_watcher));
+    w->wd = -1;
+    w->next = n->free;
+    n->free = w;
+}
+
+
+/* The event of the previous await carries the wd of the watch, the table
+ * is only scanned for the first one or after the kernel dropped it. */
+static struct caio_inotify_watcher *
+_find(struct caio_inotify *n, struct caio_task *task, const char *path,
+        const struct caio_inotify_event *event) {
+    int i;
+    struct caio_inotify_watcher *w;
+
+    for (w = *_bucket(n, event->wd); w; w = w->next) {
+        if ((w->task == task) && (w->wd == event->wd) &&
+                (strcmp(w->path, path) == 0)) {
+            return w;
+        }
+    }
+
+    for (i = 0; i < n->maxwatchers; i++) {
+        w = &n->watchers[i];
+        if ((w->task == task) && (strcmp(w->path, path) == 0)) {
+            return w;
+        }
+    }
+
+    return NULL;
+}
+
+
+/* Wake the waiters up with the error of the dispatcher */
+static void
+_abort(struct caio_inotify *n, int eno) {
+    int i;
+    struct caio_inotify_watcher *w;
+
+    for (i = 0; (i < n->maxwatchers) && n->waiters; i++) {
+        w = &n->watchers[i];
+        if (!w->waiting) {
+            continue;
+        }
+
+        w->waiting = false;
+        n->waiters--;
+        if (w->task->status == CAIO_WAITING) {
+            w->task->eno = eno;
+            caio_task_wake(w->task, CAIO_TERMINATING);
+        }
+    }
+}
+
+
+static void
+_fire(struct caio_inotify *n, struct caio_inotify_watcher *w,
+        const struct inotify_event *ev) {
+    struct caio_inotify_event *e = &w->pending;
+
+    if (e->mask == 0) {
+        e->wd = ev->wd;
+        e->cookie = ev->cookie;
+        e->name[0] = 0;
+    }
+
+    e->mask |= ev->mask;
+    if (ev->len) {
+        strncpy(e->name, ev->name, NAME_MAX);
+        e->name[NAME_MAX] = 0;
+    }
+
+    if (w->waiting && (!w->fired)) {
+        w->fired = true;
+        w->nextfired = n->fired;
+        n->fired = w;
+    }
+}
+
+
+static void
+_coalesce(struct caio_inotify *n, const struct inotify_event *ev) {
+    int i;
+    struct caio_inotify_watcher *w;
+    struct caio_inotify_watcher **ptr;
+
+    if (ev->mask & IN_Q_OVERFLOW) {
+        for (i = 0; i < n->maxwatchers; i++) {
+            if (n->watchers[i].task) {
+                _fire(n, &n->watchers[i], ev);
+            }
+        }
+        return;
+    }
+
+    ptr = _bucket(n, ev->wd);
+    while ((w = *ptr)) {
+        if (w->wd != ev->wd) {
+            ptr = &w->next;
+            continue;
+        }
+
+        if (ev->mask & (w->mask | INOTIFY_ALWAYS)) {
+            _fire(n, w, ev);
+        }
+
+        /* The kernel has already removed the watch, the next await adds it
+         * again if the path exists */
+        if (ev->mask & IN_IGNORED) {
+            *ptr = w->next;
+            w->next = NULL;
+            w->wd = -1;
+            continue;
+        }
+
+        ptr = &w->next;
+    }
+}
+
+
+static int
+_read(struct caio_inotify *n) {
+    ssize_t bytes;
+    char *ptr;
+    const struct inotify_event *ev;
+    struct caio_inotify_watcher *w;
+    char buff[INOTIFY_BUFFSIZE]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    /* Read as much as possible in one go */
+    while (true) {
+        bytes = read(n->fd, buff, INOTIFY_BUFFSIZE);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            break;
+        }
+
+        if (bytes <= 0) {
+            return -1;
+        }
+
+        for (ptr = buff; ptr < buff + bytes;
+                ptr += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *) ptr;
+            _coalesce(n, ev);
+        }
+    }
+    errno = 0;
+
+    /* Wake up the waiters, once per batch */
+    while ((w = n->fired)) {
+        n->fired = w->nextfired;
+        w->nextfired = NULL;
+        w->fired = false;
+        w->waiting = false;
+        n->waiters--;
+
+        memcpy(w->event, &w->pending, sizeof(struct caio_inotify_event));
+        w->pending.mask = 0;
+        if (w->task->status == CAIO_WAITING) {
+            caio_task_wake(w->task, CAIO_RUNNING);
+        }
+    }
+
+    return 0;
+}
+
+
+static struct caio_task *
+_dispatcher_spawn(struct caio_inotify *n);
+
+
+static ASYNC
+_dispatchA(struct caio_task *self, struct caio_inotify *n) {
+    CAIO_BEGIN(self);
+
+    while (n->waiters) {
+        CAIO_FILE_AWAIT(n->iomodule, self, n->fd, CAIO_IN);
+        if (_read(n)) {
+            CAIO_THROW(self, errno? errno: EIO);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(n->iomodule, n->fd);
+    n->dispatcher = NULL;
+
+    /* Killed while there are waiters, a new one takes over, or failed */
+    if (n->waiters && (CAIO_HASERROR(self) ||
+                ((n->dispatcher = _dispatcher_spawn(n)) == NULL))) {
+        _abort(n, CAIO_HASERROR(self)? self->eno: ECANCELED);
+    }
+}
+
+
+static struct caio_task *
+_dispatcher_spawn(struct caio_inotify *n) {
+    struct caio_task *task = caio_task_new(n->caio);
+
+    if (task == NULL) {
+        return NULL;
+    }
+
+    if (caio_inotify_call_new(task, _dispatchA, n)) {
+        caio_task_dispose(task);
+        return NULL;
+    }
+
+    return task;
+}
+
+
+int
+caio_inotify_watch(struct caio_inotify *n, struct caio_task *task,
+        const char *path, uint32_t mask, struct caio_inotify_event *event) {
+    int wd;
+    bool created = false;
+    struct caio_inotify_watcher *w;
+
+    if ((n == NULL) || (task == NULL) || (path == NULL) || (event == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w = _find(n, task, path, event);
+    if (w == NULL) {
+        w = n->free;
+        if (w == NULL) {
+            errno = ENOSPC;
+            return -1;
+        }
+
+        w->path = strdup(path);
+        if (w->path == NULL) {
+            return -1;
+        }
+        n->free = w->next;
+        w->next = NULL;
+        w->task = task;
+        created = true;
+    }
+    else if ((w->wd != -1) && (mask & ~w->mask)) {
+        /* Other watchers may be watching the same path with another mask */
+        if (inotify_add_watch(n->fd, path, mask | IN_MASK_ADD) == -1) {
+            return -1;
+        }
+    }
+    w->mask = mask;
+    w->event = event;
+
+    /* Events arrived while the task was not awaiting, no need to wait */
+    if (w->pending.mask) {
+        memcpy(event, &w->pending, sizeof(struct caio_inotify_event));
+        w->pending.mask = 0;
+        caio_task_wake(task, CAIO_RUNNING);
+        return 0;
+    }
+
+    if (w->wd == -1) {
+        wd = inotify_add_watch(n->fd, path, mask | IN_MASK_ADD);
+        if (wd == -1) {
+            goto failed;
+        }
+
+        w->wd = wd;
+        _link(n, w);
+    }
+    event->wd = w->wd;
+
+    /* A killed one takes care of the waiters in it's CAIO_FINALLY */
+    if ((n->dispatcher == NULL) &&
+            ((n->dispatcher = _dispatcher_spawn(n)) == NULL)) {
+        goto failed;
+    }
+
+    w->waiting = true;
+    n->waiters++;
+    return 0;
+
+failed:
+    if (created) {
+        _release(n, w);
+    }
+
+    return -1;
+}
+
+
+int
+caio_inotify_forget(struct caio_inotify *n, struct caio_task *task) {
+    int i;
+    int ret = -1;
+
+    if ((n == NULL) || (task == NULL)) {
+        return -1;
+    }
+
+    for (i = 0; i < n->maxwatchers; i++) {
+        if (n->watchers[i].task == task) {
+            _release(n, &n->watchers[i]);
+            ret = 0;
+        }
+    }
+
+    /* Nobody is waiting anymore, the dispatcher exits when it runs out of
+     * events, unless a new waiter comes in meanwhile */
+    if ((n->waiters == 0) && n->dispatcher &&
+            (n->dispatcher->status == CAIO_WAITING)) {
+        caio_task_wake(n->dispatcher, CAIO_RUNNING);
+    }
+
+    return ret;
+}
+
+
+struct caio_inotify *
+caio_inotify_create(struct caio *c, struct caio_iomodule *iom,
+        size_t maxwatchers) {
+    int i;
+    struct caio_inotify *n;
+
+    if ((c == NULL) || (iom == NULL) || (maxwatchers == 0)) {
+        return NULL;
+    }
+
+    n = malloc(sizeof(struct caio_inotify));
+    if (n == NULL) {
+        return NULL;
+    }
+    memset(n, 0, sizeof(struct caio_inotify));
+
+    n->caio = c;
+    n->iomodule = iom;
+    n->maxwatchers = maxwatchers;
+    n->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (n->fd == -1) {
+        goto failed;
+    }
+
+    n->watchers = calloc(maxwatchers, sizeof(struct caio_inotify_watcher));
+    if (n->watchers == NULL) {
+        goto failed;
+    }
+
+    for (i = maxwatchers - 1; i >= 0; i--) {
+        n->watchers[i].wd = -1;
+        n->watchers[i].next = n->free;
+        n->free = &n->watchers[i];
+    }
+
+    /* Power of two, at least one bucket per watcher */
+    for (i = 1; i < maxwatchers; i <<= 1) {}
+    n->tablemask = i - 1;
+    n->table = calloc(i, sizeof(struct caio_inotify_watcher *));
+    if (n->table == NULL) {
+        goto failed;
+    }
+
+    return n;
+
+failed:
+    if (n->fd != -1) {
+        close(n->fd);
+    }
+
+    free(n->watchers);
+    free(n);
+    return NULL;
+}
+
+
+int
+caio_inotify_destroy(struct caio *c, struct caio_inotify *n) {
+    int i;
+
+    if (n == NULL) {
+        return -1;
+    }
+
+    if (n->fd != -1) {
+        close(n->fd);
+    }
+
+    if (n->watchers) {
+        for (i = 0; i < n->maxwatchers; i++) {
+            free(n->watchers[i].path);
+        }
+        free(n->watchers);
+    }
+
+    free(n->table);
+    free(n);
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_INOTIFY_H_
+#define CAIO_INOTIFY_H_
+
+
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/inotify.h>
+
+#include "caio/caio.h"
+
+
+/* All events of the same watch read in one batch are coalesced into one
+ * event, mask is the union of their masks and name is the latest one. */
+struct caio_inotify_event {
+    int wd;
+    uint32_t mask;
+    uint32_t cookie;
+    char name[NAME_MAX + 1];
+};
+
+
+struct caio_inotify;
+
+
+/* Creates the loop's inotify(7) instance, an extra task is leased from the
+ * taskpool while there is at least one waiter, to await the inotify file
+ * descriptor on the given iomodule and dispatch the events. */
+struct caio_inotify *
+caio_inotify_create(struct caio *c, struct caio_iomodule *iom,
+        size_t maxwatchers);
+
+
+int
+caio_inotify_destroy(struct caio *c, struct caio_inotify *n);
+
+
+/* The watch is kept until the task forgets it, events arriving in between
+ * two awaits of the same path are coalesced and delivered by the next one
+ * without waiting. The task is parked by CAIO_WATCH_AWAIT and woken up
+ * with an errno if the dispatcher fails. */
+int
+caio_inotify_watch(struct caio_inotify *n, struct caio_task *task,
+        const char *path, uint32_t mask, struct caio_inotify_event *event);
+
+
+int
+caio_inotify_forget(struct caio_inotify *n, struct caio_task *task);
+
+
+#define CAIO_WATCH_FORGET(inotify, task) caio_inotify_forget(inotify, task)
+#define CAIO_WATCH_AWAIT(inotify, task, path, mask, event) \
+    do { \
+        (task)->current->line = __LINE__; \
+        (task)->fd = -1; \
+        (task)->events = 0; \
+        (task)->status = CAIO_WAITING; \
+        if (caio_inotify_watch(inotify, task, path, mask, event)) { \
+            (task)->eno = errno; \
+            (task)->status = CAIO_TERMINATING; \
+        } \
+        return; \
+        case __LINE__:; \
+    } while (0)
+
+
+#endif  // CAIO_INOTIFY_H_
@@ -0,0 +1,352 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+
+#include "caio/caio.h"
+#include "caio/sleep.h"
+#include "caio/process.h"
+#include "caio/prefork.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+/* Minimum lifetime of a worker in miliseconds, crashed workers younger than
+ * this will be restarted after the same delay to prevent fork storms. */
+#define WORKER_MINLIFETIME 1000
+
+
+struct caio_prefork;
+typedef struct caio_worker {
+    unsigned int index;
+    struct caio_process process;
+    caio_sleep_t sleep;
+    unsigned long long started;
+    struct caio_prefork *prefork;
+} caio_worker_t;
+
+
+struct caio_prefork {
+    struct caio *caio;
+    struct caio_iomodule *iomodule;
+    size_t maxtasks;
+    caio_prefork_setup setup;
+    void *arg;
+    struct caio_worker *workers;
+    unsigned int workerscount;
+    unsigned int running;
+
+    /* SIGINT and SIGTERM are blocked and read by the signals task */
+    sigset_t oldmask;
+    int sigfd;
+    struct caio_task *signals;
+};
+
+
+typedef struct caio_prefork caio_prefork_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_worker
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_prefork
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static struct caio *_supervisor;
+
+
+static void
+_child(struct caio_worker *w) {
+    int i;
+    int status;
+    struct caio *c;
+    struct caio_prefork *p = w->prefork;
+
+    close(p->sigfd);
+    sigprocmask(SIG_SETMASK, &p->oldmask, NULL);
+    _supervisor = NULL;
+
+    /* Supervisor's file descriptors are useless here */
+    for (i = 0; i < p->workerscount; i++) {
+        caio_process_close(&p->workers[i].process);
+
+        if (p->workers[i].sleep != -1) {
+            close(p->workers[i].sleep);
+        }
+    }
+
+    /* Including the supervisor's epoll instance, it's caio is left alone
+     * because destroying it would also unlink it's shared stats page. */
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(p->caio, (struct caio_epoll*)p->iomodule);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(p->caio, (struct caio_select*)p->iomodule);
+#endif
+    p->iomodule = NULL;
+
+    c = caio_create(p->maxtasks);
+    if (c == NULL) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (p->setup(c, w->index, p->arg)) {
+        exit(EXIT_FAILURE);
+    }
+
+    status = caio_loop(c)? EXIT_FAILURE: EXIT_SUCCESS;
+    caio_destroy(c);
+    exit(status);
+}
+
+
+static int
+_fork(struct caio_worker *w) {
+    pid_t pid;
+
+    pid = fork();
+    if (pid == -1) {
+        return -1;
+    }
+
+    if (pid == 0) {
+        _child(w);
+    }
+
+    if (caio_process_attach(&w->process, pid)) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+
+    w->started = caio_now(w->prefork->caio);
+    return 0;
+}
+
+
+static time_t
+_uptime(struct caio_worker *w) {
+    return (caio_now(w->prefork->caio) - w->started) / 1000000;
+}
+
+
+static ASYNC
+_workerA(struct caio_task *self, struct caio_worker *w) {
+    struct caio_iomodule *iom = w->prefork->iomodule;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        if (_fork(w)) {
+            CAIO_THROW(self, errno);
+        }
+
+        CAIO_WAITPID(self, &w->process, iom);
+        if (CAIO_HASERROR(self)) {
+            CAIO_RETHROW(self);
+        }
+
+        /* Exited gracefully */
+        if (WIFEXITED(w->process.status) &&
+                (WEXITSTATUS(w->process.status) == 0)) {
+            break;
+        }
+
+        if (_uptime(w) < WORKER_MINLIFETIME) {
+            CAIO_SLEEP(self, &w->sleep, iom, WORKER_MINLIFETIME);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    if (w->process.pid > 0) {
+        kill(w->process.pid, SIGTERM);
+        waitpid(w->process.pid, NULL, 0);
+        w->process.pid = -1;
+    }
+
+    if (w->process.pidfd != -1) {
+        CAIO_FILE_FORGET(iom, w->process.pidfd);
+        caio_process_close(&w->process);
+    }
+
+    /* The last one, nothing is left to stop */
+    if ((--w->prefork->running == 0) && w->prefork->signals &&
+            (w->prefork->signals->status == CAIO_WAITING)) {
+        caio_task_wake(w->prefork->signals, CAIO_TERMINATING);
+    }
+}
+
+
+/* Stops the workers on SIGINT or SIGTERM, the signals are read from a
+ * signalfd(2) so the tasks are killed from within the loop rather than a
+ * signal handler. */
+static ASYNC
+_signalsA(struct caio_task *self, struct caio_prefork *p) {
+    struct signalfd_siginfo info;
+    CAIO_BEGIN(self);
+    p->signals = self;
+
+    while (read(p->sigfd, &info, sizeof(info)) != sizeof(info)) {
+        if (!IO_MUSTWAIT(errno)) {
+            CAIO_THROW(self, errno);
+        }
+
+        CAIO_FILE_AWAIT(p->iomodule, self, p->sigfd, CAIO_IN);
+    }
+
+    caio_task_killall(self->caio);
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(p->iomodule, p->sigfd);
+    p->signals = NULL;
+}
+
+
+int
+caio_prefork(unsigned int workers, size_t maxtasks, caio_prefork_setup setup,
+        void *arg) {
+    int i;
+    int ret = -1;
+    struct caio_prefork p;
+    struct caio_worker *w;
+    struct signalfd_siginfo info;
+    sigset_t signals;
+
+    if ((workers == 0) || (setup == NULL) || (_supervisor != NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(&p, 0, sizeof(p));
+    p.sigfd = -1;
+    p.maxtasks = maxtasks;
+    p.setup = setup;
+    p.arg = arg;
+    p.workers = calloc(workers, sizeof(struct caio_worker));
+    if (p.workers == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < workers; i++) {
+        w = &p.workers[i];
+        w->index = i;
+        caio_process_init(&w->process, 0);
+        w->prefork = &p;
+        if (caio_sleep_create(&w->sleep)) {
+            w->sleep = -1;
+            goto terminate;
+        }
+        p.workerscount++;
+    }
+
+    /* The workers and the signals task */
+    p.caio = caio_create(workers + 1);
+    if (p.caio == NULL) {
+        goto terminate;
+    }
+
+#ifdef CAIO_EPOLL
+    p.iomodule = (struct caio_iomodule*)caio_epoll_create(p.caio,
+            workers + 1, 100);
+#elif defined(CAIO_SELECT)
+    p.iomodule = (struct caio_iomodule*)caio_select_create(p.caio,
+            FD_SETSIZE - 3, 100000);
+#endif
+    if (p.iomodule == NULL) {
+        goto terminate;
+    }
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (sigprocmask(SIG_BLOCK, &signals, &p.oldmask)) {
+        goto terminate;
+    }
+
+    _supervisor = p.caio;
+    p.sigfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if ((p.sigfd == -1) ||
+            caio_prefork_spawn(p.caio, _signalsA, &p)) {
+        goto restore;
+    }
+
+    for (i = 0; i < workers; i++) {
+        if (caio_worker_spawn(p.caio, _workerA, &p.workers[i])) {
+            break;
+        }
+        p.running++;
+    }
+
+    /* Let the ones already spawned stop, if any of them has failed */
+    if (i < workers) {
+        caio_task_killall(p.caio);
+    }
+
+    if ((caio_loop(p.caio) == 0) && (i == workers)) {
+        ret = 0;
+    }
+
+restore:
+    /* Drop the signals received meanwhile, they are handled already */
+    if (p.sigfd != -1) {
+        while (read(p.sigfd, &info, sizeof(info)) == sizeof(info)) {}
+        close(p.sigfd);
+    }
+    sigprocmask(SIG_SETMASK, &p.oldmask, NULL);
+
+terminate:
+    _supervisor = NULL;
+    if (p.iomodule) {
+#ifdef CAIO_EPOLL
+        caio_epoll_destroy(p.caio, (struct caio_epoll*)p.iomodule);
+#elif defined(CAIO_SELECT)
+        caio_select_destroy(p.caio, (struct caio_select*)p.iomodule);
+#endif
+    }
+
+    if (p.caio) {
+        caio_destroy(p.caio);
+    }
+
+    for (i = 0; i < p.workerscount; i++) {
+        caio_sleep_destroy(&p.workers[i].sleep);
+    }
+
+    free(p.workers);
+    return ret;
+}
@@ -0,0 +1,49 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_PREFORK_H_
+#define CAIO_PREFORK_H_
+
+
+#include "caio/caio.h"
+
+
+/* Called inside each freshly forked worker with it's own caio instance.
+ * The worker must install it's modules and spawn it's tasks here, then it
+ * runs caio_loop until no task is left and exits.
+ * Non-zero return value terminates the worker with EXIT_FAILURE. */
+typedef int (*caio_prefork_setup) (struct caio *c, unsigned int index,
+        void *arg);
+
+
+/* Forks the given number of workers and supervises them until all of them
+ * exits gracefully (status zero) or SIGINT/SIGTERM is received.
+ *
+ * Listeners must be bound before calling this function, so they are bound
+ * once and inherited by all workers. Crashed workers (killed by a signal or
+ * non-zero exit status) will be forked again.
+ *
+ * The supervisor awaits the workers using pidfd(2) inside it's own caio
+ * loop. SIGINT and SIGTERM are blocked meanwhile and read through a
+ * signalfd(2), the workers are forked with the original signal mask. */
+int
+caio_prefork(unsigned int workers, size_t maxtasks, caio_prefork_setup setup,
+        void *arg);
+
+
+#endif  // CAIO_PREFORK_H_
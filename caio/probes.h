@@ -0,0 +1,48 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_PROBES_H_
+#define CAIO_PROBES_H_
+
+
+/* USDT probes of the "caio" provider, a single nop each when not attached:
+ *
+ *   task_lease(task, count)          task_release(task, count)
+ *   step_begin(task, function, line) step_end(task, function, status)
+ *   file_await(task, fd, events)     file_forget(fd)
+ *   wait_begin(module, waitingfiles) wait_end(module, nfds)
+ *
+ * List them with: bpftrace -l 'usdt:/path/to/binary:caio:*' */
+#ifdef CAIO_USDT
+
+#include <sys/sdt.h>
+
+#define CAIO_PROBE1(name, a) DTRACE_PROBE1(caio, name, a)
+#define CAIO_PROBE2(name, a, b) DTRACE_PROBE2(caio, name, a, b)
+#define CAIO_PROBE3(name, a, b, c) DTRACE_PROBE3(caio, name, a, b, c)
+
+#else
+
+#define CAIO_PROBE1(name, a)
+#define CAIO_PROBE2(name, a, b)
+#define CAIO_PROBE3(name, a, b, c)
+
+#endif  // CAIO_USDT
+
+
+#endif  // CAIO_PROBES_H_
@@ -0,0 +1,272 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "caio/caio.h"
+#include "caio/process.h"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_process
+#define CAIO_ARG1 char *const *
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_waitpid
+#define CAIO_ARG1 struct caio_iomodule *
+#include "caio/generic.c"  // NOLINT
+
+
+extern char **environ;
+
+
+#define PIPE_RESET(p) \
+    (p)[0] = -1; \
+    (p)[1] = -1
+
+
+#define PIPE_CLOSE(p) \
+    if ((p)[0] != -1) close((p)[0]); \
+    if ((p)[1] != -1) close((p)[1]); \
+    PIPE_RESET(p)
+
+
+static int
+_pidfd_open(pid_t pid) {
+    return syscall(SYS_pidfd_open, pid, 0);
+}
+
+
+static int
+_pipe(int fds[2], int parentside) {
+    if (pipe2(fds, O_CLOEXEC)) {
+        return -1;
+    }
+
+    if (fcntl(fds[parentside], F_SETFL, O_NONBLOCK)) {
+        PIPE_CLOSE(fds);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+caio_process_init(struct caio_process *p, int pipes) {
+    if (p == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    p->pid = -1;
+    p->pidfd = -1;
+    p->in = -1;
+    p->out = -1;
+    p->err = -1;
+    p->pipes = pipes;
+    p->status = 0;
+    return 0;
+}
+
+
+int
+caio_process_attach(struct caio_process *p, pid_t pid) {
+    int fd;
+
+    if ((p == NULL) || (pid <= 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    fd = _pidfd_open(pid);
+    if (fd == -1) {
+        return -1;
+    }
+
+    p->pid = pid;
+    p->pidfd = fd;
+    p->status = 0;
+    return 0;
+}
+
+
+int
+caio_process_close(struct caio_process *p) {
+    if (p == NULL) {
+        return -1;
+    }
+
+    if (p->pidfd != -1) {
+        close(p->pidfd);
+        p->pidfd = -1;
+    }
+
+    if (p->in != -1) {
+        close(p->in);
+        p->in = -1;
+    }
+
+    if (p->out != -1) {
+        close(p->out);
+        p->out = -1;
+    }
+
+    if (p->err != -1) {
+        close(p->err);
+        p->err = -1;
+    }
+
+    return 0;
+}
+
+
+static int
+_spawn(struct caio_process *p, char *const argv[]) {
+    int ret = -1;
+    int eno;
+    pid_t pid;
+    int in[2] = {-1, -1};
+    int out[2] = {-1, -1};
+    int err[2] = {-1, -1};
+    posix_spawn_file_actions_t actions;
+
+    if (posix_spawn_file_actions_init(&actions)) {
+        return -1;
+    }
+
+    if (p->pipes & CAIO_PROCESS_STDIN) {
+        if (_pipe(in, 1) ||
+                posix_spawn_file_actions_adddup2(&actions, in[0], 0)) {
+            goto done;
+        }
+    }
+
+    if (p->pipes & CAIO_PROCESS_STDOUT) {
+        if (_pipe(out, 0) ||
+                posix_spawn_file_actions_adddup2(&actions, out[1], 1)) {
+            goto done;
+        }
+    }
+
+    if (p->pipes & CAIO_PROCESS_STDERR) {
+        if (_pipe(err, 0) ||
+                posix_spawn_file_actions_adddup2(&actions, err[1], 2)) {
+            goto done;
+        }
+    }
+
+    /* posix_spawnp(3) reports the exec(3) failures itself */
+    eno = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+    if (eno) {
+        errno = eno;
+        goto done;
+    }
+
+    if (caio_process_attach(p, pid)) {
+        eno = errno;
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        errno = eno;
+        goto done;
+    }
+
+    /* Keep the parent side */
+    p->in = in[1];
+    p->out = out[0];
+    p->err = err[0];
+    in[1] = -1;
+    out[0] = -1;
+    err[0] = -1;
+    ret = 0;
+
+done:
+    eno = errno;
+    posix_spawn_file_actions_destroy(&actions);
+    PIPE_CLOSE(in);
+    PIPE_CLOSE(out);
+    PIPE_CLOSE(err);
+    errno = eno;
+    return ret;
+}
+
+
+ASYNC
+caio_process_spawnA(struct caio_task *self, struct caio_process *p,
+        char *const argv[]) {
+    CAIO_BEGIN(self);
+
+    if ((argv == NULL) || (argv[0] == NULL) || (p->pid != -1)) {
+        CAIO_THROW(self, EINVAL);
+    }
+
+    if (_spawn(p, argv)) {
+        CAIO_THROW(self, errno);
+    }
+
+    CAIO_FINALLY(self);
+}
+
+
+ASYNC
+caio_waitpidA(struct caio_task *self, struct caio_process *p,
+        struct caio_iomodule *iom) {
+    pid_t pid;
+    int status;
+    CAIO_BEGIN(self);
+
+    if (p->pidfd == -1) {
+        CAIO_THROW(self, EINVAL);
+    }
+
+    while (true) {
+        pid = waitpid(p->pid, &status, WNOHANG);
+        if (pid == p->pid) {
+            p->status = status;
+            break;
+        }
+
+        if (pid == -1) {
+            CAIO_THROW(self, errno);
+        }
+
+        /* pidfd(2) becomes readable when the child exits */
+        CAIO_FILE_AWAIT(iom, self, p->pidfd, CAIO_IN);
+    }
+
+    CAIO_FILE_FORGET(iom, p->pidfd);
+    close(p->pidfd);
+    p->pidfd = -1;
+    p->pid = -1;
+
+    CAIO_FINALLY(self);
+}
@@ -0,0 +1,101 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_PROCESS_H_
+#define CAIO_PROCESS_H_
+
+
+#include <sys/types.h>
+
+#include "caio/caio.h"
+
+
+/* Pipes to create for the child, see caio_process_init */
+#define CAIO_PROCESS_STDIN 0x1
+#define CAIO_PROCESS_STDOUT 0x2
+#define CAIO_PROCESS_STDERR 0x4
+
+
+/* in, out and err are the parent side of the child's standard streams, all
+ * of them are non-blocking and ready to use with CAIO_FILE_AWAIT, or -1 if
+ * not requested. status is the wait status of the exited child. */
+typedef struct caio_process {
+    pid_t pid;
+    int pidfd;
+    int in;
+    int out;
+    int err;
+    int pipes;
+    int status;
+} caio_process_t;
+
+
+typedef struct caio_process caio_waitpid_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_process
+#define CAIO_ARG1 char *const *
+#include "caio/generic.h"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_waitpid
+#define CAIO_ARG1 struct caio_iomodule *
+#include "caio/generic.h"  // NOLINT
+
+
+int
+caio_process_init(struct caio_process *p, int pipes);
+
+
+/* Open a pidfd for an already forked child, so it can be awaited using
+ * CAIO_WAITPID. */
+int
+caio_process_attach(struct caio_process *p, pid_t pid);
+
+
+/* Close the pipes and the pidfd, the child itself is not touched. */
+int
+caio_process_close(struct caio_process *p);
+
+
+ASYNC
+caio_process_spawnA(struct caio_task *self, struct caio_process *p,
+        char *const argv[]);
+
+
+ASYNC
+caio_waitpidA(struct caio_task *self, struct caio_process *p,
+        struct caio_iomodule *iom);
+
+
+#define CAIO_SPAWN_PROCESS(self, process, argv) \
+    CAIO_AWAIT(self, caio_process, caio_process_spawnA, process, argv)
+
+
+#define CAIO_WAITPID(self, process, iom) \
+    CAIO_AWAIT(self, caio_waitpid, caio_waitpidA, process, \
+            (struct caio_iomodule*)iom)
+
+
+#endif  // CAIO_PROCESS_H_
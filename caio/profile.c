@@ -0,0 +1,160 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "caio/profile.h"
+#include "caio/symbol.h"
+
+
+#define SLOT_EMPTY 0
+#define SLOT_BUSY 1
+#define SLOT_READY 2
+
+
+static struct caio_profslot _slots[CAIO_PROFILE_SLOTS];
+static unsigned long _overflows;
+
+
+static inline size_t
+_hash(const void *coro, int line) {
+    uint64_t h = ((uintptr_t)coro >> 4) ^ ((uint64_t)line << 32);
+
+    h *= 0x9e3779b97f4a7c15ULL;
+    return (h >> 32) % CAIO_PROFILE_SLOTS;
+}
+
+
+struct caio_profslot *
+caio_profile_slot(const void *coro, int line) {
+    int state;
+    size_t i;
+    size_t probe;
+    struct caio_profslot *slot;
+
+    i = _hash(coro, line);
+    for (probe = 0; probe < CAIO_PROFILE_SLOTS; probe++) {
+        slot = _slots + ((i + probe) % CAIO_PROFILE_SLOTS);
+        state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+
+        if (state == SLOT_EMPTY) {
+            if (__atomic_compare_exchange_n(&slot->state, &state, SLOT_BUSY,
+                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                slot->coro = coro;
+                slot->line = line;
+                __atomic_store_n(&slot->state, SLOT_READY, __ATOMIC_RELEASE);
+                return slot;
+            }
+        }
+
+        /* Another thread is claiming this slot, the key is not there yet */
+        while (state == SLOT_BUSY) {
+            state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        }
+
+        if ((slot->coro == coro) && (slot->line == line)) {
+            return slot;
+        }
+    }
+
+    __atomic_fetch_add(&_overflows, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+
+static int
+_slotcmp(const void *a, const void *b) {
+    const struct caio_profslot *x = *(const struct caio_profslot **)a;
+    const struct caio_profslot *y = *(const struct caio_profslot **)b;
+
+    if (x->wait.sum != y->wait.sum) {
+        return (x->wait.sum < y->wait.sum)? 1: -1;
+    }
+
+    if (x->cpu.sum != y->cpu.sum) {
+        return (x->cpu.sum < y->cpu.sum)? 1: -1;
+    }
+
+    return 0;
+}
+
+
+int
+caio_profile_dump(FILE *out, size_t top) {
+    int i;
+    size_t count = 0;
+    char name[256];
+    struct caio_profslot *slot;
+    struct caio_profslot *sorted[CAIO_PROFILE_SLOTS];
+
+    for (i = 0; i < CAIO_PROFILE_SLOTS; i++) {
+        slot = _slots + i;
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == SLOT_READY) {
+            sorted[count++] = slot;
+        }
+    }
+
+    qsort(sorted, count, sizeof(struct caio_profslot *), _slotcmp);
+    if (top && (top < count)) {
+        count = top;
+    }
+
+    fprintf(out, "# point\twaits\twait_p50\twait_p99\twait_max\twait_total"
+            "\truns\tcpu_p50\tcpu_p99\tcpu_max\tcpu_total\n");
+    for (i = 0; i < count; i++) {
+        slot = sorted[i];
+        caio_symbol(slot->coro, name, sizeof(name));
+        fprintf(out, "%s:%d\t%lu\t%llu\t%llu\t%llu\t%llu"
+                "\t%lu\t%llu\t%llu\t%llu\t%llu\n",
+                name, slot->line,
+                slot->wait.count,
+                caio_hist_percentile(&slot->wait, 50) / 1000,
+                caio_hist_percentile(&slot->wait, 99) / 1000,
+                slot->wait.max / 1000,
+                slot->wait.sum / 1000,
+                slot->cpu.count,
+                caio_hist_percentile(&slot->cpu, 50) / 1000,
+                caio_hist_percentile(&slot->cpu, 99) / 1000,
+                slot->cpu.max / 1000,
+                slot->cpu.sum / 1000);
+    }
+
+    if (_overflows) {
+        fprintf(out, "# overflows\t%lu\n", _overflows);
+    }
+
+    return fflush(out);
+}
+
+
+void
+caio_profile_reset() {
+    int i;
+
+    for (i = 0; i < CAIO_PROFILE_SLOTS; i++) {
+        if (__atomic_load_n(&_slots[i].state, __ATOMIC_ACQUIRE) ==
+                SLOT_READY) {
+            caio_hist_reset(&_slots[i].wait);
+            caio_hist_reset(&_slots[i].cpu);
+        }
+    }
+    _overflows = 0;
+}
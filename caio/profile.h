@@ -0,0 +1,82 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_PROFILE_H_
+#define CAIO_PROFILE_H_
+
+
+#include <stdio.h>
+
+#include "caio/hist.h"
+
+
+/* Maximum number of distinct await points */
+#ifndef CAIO_PROFILE_SLOTS
+#define CAIO_PROFILE_SLOTS 512
+#endif
+
+
+/* One slot per await point, keyed by the coroutine and the line number of
+ * the await. The wait histogram records the time between suspension and
+ * resume at this point, the cpu histogram records the time spent running
+ * from this point until the next suspension or return. Line zero is the
+ * coroutine's entry and -1 it's CAIO_FINALLY. */
+struct caio_profslot {
+    int state;
+    int line;
+    const void *coro;
+    struct caio_hist wait;
+    struct caio_hist cpu;
+};
+
+
+/* Find or insert the slot, lock free and safe to be called from multiple
+ * loops running in different threads. Returns NULL when the table is
+ * full. */
+struct caio_profslot *
+caio_profile_slot(const void *coro, int line);
+
+
+static inline void
+caio_profile_add(struct caio_hist *h, unsigned long long value) {
+    __atomic_fetch_add(&h->buckets[caio_hist_bucket(value)], 1,
+            __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+    if (value > __atomic_load_n(&h->max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&h->max, value, __ATOMIC_RELAXED);
+    }
+}
+
+
+/* Print the await points sorted by the total wait time, one per line:
+ *
+ *     # point  waits  wait_p50  wait_p99  wait_max  wait_total  runs  ...
+ *     echoA:118  ...
+ *
+ * Times are in microseconds, points are symbolized, so dumps of different
+ * builds can be compared with diff(1). top zero means all. */
+int
+caio_profile_dump(FILE *out, size_t top);
+
+
+void
+caio_profile_reset();
+
+
+#endif  // CAIO_PROFILE_H_
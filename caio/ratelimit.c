@@ -0,0 +1,243 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "caio/ratelimit.h"
+
+
+/* Absorbs the floating point error of the refill */
+#define EPSILON 1e-6
+
+
+struct caio_ratewaiter {
+    struct caio_task *task;
+    struct caio_basecall *call;
+    double n;
+};
+
+
+struct caio_ratelimit {
+    struct caio *caio;
+    struct caio_timers *timers;
+    struct caio_timer timer;
+
+    /* Tokens per nanosecond */
+    double rate;
+    double burst;
+    double tokens;
+    unsigned long long stamp;
+
+    /* FIFO ring of the waiters */
+    struct caio_ratewaiter *waiters;
+    size_t size;
+    size_t head;
+    size_t count;
+};
+
+
+static void
+_refill(struct caio_ratelimit *rl) {
+    unsigned long long now = caio_now(rl->caio);
+
+    if (now <= rl->stamp) {
+        return;
+    }
+
+    rl->tokens += (now - rl->stamp) * rl->rate;
+    if (rl->tokens > rl->burst) {
+        rl->tokens = rl->burst;
+    }
+    rl->stamp = now;
+}
+
+
+/* Schedule the timer for when the head waiter's tokens are refilled */
+static int
+_schedule(struct caio_ratelimit *rl) {
+    double missing;
+
+    if (rl->count == 0) {
+        return caio_timer_stop(rl->timers, &rl->timer);
+    }
+
+    missing = rl->waiters[rl->head].n - rl->tokens;
+    if (missing < 0) {
+        missing = 0;
+    }
+
+    return caio_timer_start(rl->timers, &rl->timer,
+            (unsigned long long)(missing / rl->rate) + 1, 0);
+}
+
+
+static void
+_release(struct caio_timer *t, void *arg) {
+    struct caio_ratelimit *rl = arg;
+    struct caio_ratewaiter *w;
+
+    _refill(rl);
+    while (rl->count) {
+        w = &rl->waiters[rl->head];
+
+        /* Killed, or forgotten to forget */
+        if ((w->task->status != CAIO_WAITING) ||
+                (w->task->current != w->call)) {
+            rl->head = (rl->head + 1) % rl->size;
+            rl->count--;
+            continue;
+        }
+
+        if ((rl->tokens + EPSILON) < w->n) {
+            break;
+        }
+
+        rl->tokens -= w->n;
+        caio_task_wake(w->task, CAIO_RUNNING);
+        rl->head = (rl->head + 1) % rl->size;
+        rl->count--;
+    }
+
+    _schedule(rl);
+}
+
+
+bool
+caio_ratelimit_take(struct caio_ratelimit *rl, double n) {
+    if (rl->count) {
+        return false;
+    }
+
+    _refill(rl);
+    if ((rl->tokens + EPSILON) < n) {
+        return false;
+    }
+
+    rl->tokens -= n;
+    return true;
+}
+
+
+int
+caio_ratelimit_wait(struct caio_ratelimit *rl, struct caio_task *task,
+        double n) {
+    struct caio_ratewaiter *w;
+
+    if (n > rl->burst) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (rl->count == rl->size) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    w = &rl->waiters[(rl->head + rl->count) % rl->size];
+    w->task = task;
+    w->call = task->current;
+    w->n = n;
+    if (rl->count++) {
+        return 0;
+    }
+
+    _refill(rl);
+    if (_schedule(rl)) {
+        rl->count--;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+int
+caio_ratelimit_forget(struct caio_ratelimit *rl, struct caio_task *task) {
+    size_t i;
+    size_t index;
+    size_t count = 0;
+    struct caio_ratewaiter *w;
+
+    /* Compact the ring in place */
+    for (i = 0; i < rl->count; i++) {
+        w = &rl->waiters[(rl->head + i) % rl->size];
+        if (w->task == task) {
+            continue;
+        }
+
+        index = (rl->head + count++) % rl->size;
+        rl->waiters[index] = *w;
+    }
+
+    if (count == rl->count) {
+        return 0;
+    }
+
+    rl->count = count;
+    return _schedule(rl);
+}
+
+
+struct caio_ratelimit *
+caio_ratelimit_create(struct caio *c, struct caio_timers *timers,
+        double rate, double burst, size_t maxwaiters) {
+    struct caio_ratelimit *rl;
+
+    if ((c == NULL) || (timers == NULL) || (rate <= 0) || (burst <= 0) ||
+            (maxwaiters == 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    rl = malloc(sizeof(struct caio_ratelimit));
+    if (rl == NULL) {
+        return NULL;
+    }
+    memset(rl, 0, sizeof(struct caio_ratelimit));
+
+    rl->waiters = calloc(maxwaiters, sizeof(struct caio_ratewaiter));
+    if (rl->waiters == NULL) {
+        free(rl);
+        return NULL;
+    }
+
+    rl->caio = c;
+    rl->timers = timers;
+    rl->rate = rate / 1e9;
+    rl->burst = burst;
+    rl->tokens = burst;
+    rl->stamp = caio_now(c);
+    rl->size = maxwaiters;
+    caio_timer_init(&rl->timer, _release, rl);
+    return rl;
+}
+
+
+int
+caio_ratelimit_destroy(struct caio_ratelimit *rl) {
+    if (rl == NULL) {
+        return -1;
+    }
+
+    caio_timer_stop(rl->timers, &rl->timer);
+    free(rl->waiters);
+    free(rl);
+    return 0;
+}
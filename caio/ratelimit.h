@@ -0,0 +1,85 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_RATELIMIT_H_
+#define CAIO_RATELIMIT_H_
+
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "caio/caio.h"
+#include "caio/timer.h"
+
+
+/* Token bucket: refills rate tokens per second up to burst. Tasks which
+ * can't take their tokens immediately are parked on a FIFO, and released in
+ * order by a single timer of the timers facility as the tokens refill, so
+ * there is no kernel object per waiter. */
+struct caio_ratelimit;
+
+
+struct caio_ratelimit *
+caio_ratelimit_create(struct caio *c, struct caio_timers *timers,
+        double rate, double burst, size_t maxwaiters);
+
+
+int
+caio_ratelimit_destroy(struct caio_ratelimit *rl);
+
+
+/* Take n tokens if available and no one is waiting before. */
+bool
+caio_ratelimit_take(struct caio_ratelimit *rl, double n);
+
+
+/* Park the task until n tokens are available, see
+ * CAIO_RATELIMIT_ACQUIRE. */
+int
+caio_ratelimit_wait(struct caio_ratelimit *rl, struct caio_task *task,
+        double n);
+
+
+/* Remove the task from the waiters, tasks which might be killed while
+ * waiting must call this in their CAIO_FINALLY, just like
+ * CAIO_FILE_FORGET. */
+int
+caio_ratelimit_forget(struct caio_ratelimit *rl, struct caio_task *task);
+
+
+#define CAIO_RATELIMIT_ACQUIRE(task, rl, n) \
+    do { \
+        if (!caio_ratelimit_take(rl, n)) { \
+            (task)->current->line = __LINE__; \
+            if (caio_ratelimit_wait(rl, task, n)) { \
+                (task)->eno = errno; \
+                (task)->status = CAIO_TERMINATING; \
+            } \
+            else { \
+                (task)->fd = -1; \
+                (task)->events = 0; \
+                (task)->status = CAIO_WAITING; \
+            } \
+            return; \
+            case __LINE__:; \
+        } \
+    } while (0)
+
+
+#endif  // CAIO_RATELIMIT_H_
@@ -0,0 +1,255 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "caio/sampler.h"
+#include "caio/symbol.h"
+
+
+struct frame {
+    const void *function;
+    int line;
+};
+
+
+struct sample {
+    unsigned int depth;
+    struct frame frames[CAIO_SAMPLER_DEPTH];
+};
+
+
+__thread struct caio_task * volatile caio_sampler_task;
+
+
+/* Older glibc does not define it */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+
+static struct sample *_samples;
+static size_t _capacity;
+static volatile size_t _count;
+static volatile unsigned long _dropped;
+static volatile sig_atomic_t _interrupted;
+static timer_t _timer;
+static bool _running;
+static struct sigaction _oldaction;
+
+
+/* Async signal safe: no allocation, only reads the frames which the
+ * interrupted thread does not free while it's stepping them. */
+static void
+_handler(int signo, siginfo_t *info, void *context) {
+    int saved = errno;
+    struct sample *s;
+    struct caio_task *task = caio_sampler_task;
+    struct caio_basecall *call;
+    unsigned int depth = 0;
+
+    _interrupted = 1;
+    if (_count >= _capacity) {
+        _dropped++;
+        goto done;
+    }
+
+    s = _samples + _count;
+    if (task) {
+        call = task->current;
+        while (call && (depth < CAIO_SAMPLER_DEPTH)) {
+            s->frames[depth].function = call->function;
+            s->frames[depth].line = call->line;
+            call = call->parent;
+            depth++;
+        }
+    }
+    s->depth = depth;
+    _count++;
+
+done:
+    errno = saved;
+}
+
+
+int
+caio_sampler_start(unsigned int hz, size_t capacity) {
+    struct sigaction sa;
+    struct sigevent sev;
+    struct itimerspec its;
+
+    if (_running || (hz == 0) || (hz > 1000000) || (capacity == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (_capacity != capacity) {
+        free(_samples);
+        _samples = calloc(capacity, sizeof(struct sample));
+        if (_samples == NULL) {
+            _capacity = 0;
+            return -1;
+        }
+        _capacity = capacity;
+    }
+    caio_sampler_reset();
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = _handler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, &_oldaction)) {
+        return -1;
+    }
+
+    /* Deliver the signal to this thread only, driven by it's cpu time */
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev.sigev_notify_thread_id = gettid();
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &_timer)) {
+        goto failed;
+    }
+
+    its.it_interval.tv_sec = 1 / hz;
+    its.it_interval.tv_nsec = (1000000000ULL / hz) % 1000000000ULL;
+    its.it_value = its.it_interval;
+    if (timer_settime(_timer, 0, &its, NULL)) {
+        timer_delete(_timer);
+        goto failed;
+    }
+
+    _running = true;
+    return 0;
+
+failed:
+    sigaction(SIGPROF, &_oldaction, NULL);
+    return -1;
+}
+
+
+int
+caio_sampler_stop() {
+    if (!_running) {
+        return -1;
+    }
+
+    timer_delete(_timer);
+    sigaction(SIGPROF, &_oldaction, NULL);
+    _running = false;
+    return 0;
+}
+
+
+bool
+caio_sampler_interrupted() {
+    if (!_interrupted) {
+        return false;
+    }
+
+    _interrupted = 0;
+    return true;
+}
+
+
+void
+caio_sampler_reset() {
+    _count = 0;
+    _dropped = 0;
+}
+
+
+static int
+_samplecmp(const void *a, const void *b) {
+    int i;
+    const struct sample *x = a;
+    const struct sample *y = b;
+
+    /* Compare from the root */
+    for (i = 1; (i <= x->depth) && (i <= y->depth); i++) {
+        if (x->frames[x->depth - i].function !=
+                y->frames[y->depth - i].function) {
+            return (x->frames[x->depth - i].function <
+                    y->frames[y->depth - i].function)? -1: 1;
+        }
+
+        if (x->frames[x->depth - i].line != y->frames[y->depth - i].line) {
+            return x->frames[x->depth - i].line -
+                y->frames[y->depth - i].line;
+        }
+    }
+
+    return (int)x->depth - (int)y->depth;
+}
+
+
+static void
+_print(FILE *out, const struct sample *s, unsigned long count) {
+    int i;
+    char name[256];
+
+    fprintf(out, "caio_loop");
+    for (i = s->depth - 1; i >= 0; i--) {
+        caio_symbol(s->frames[i].function, name, sizeof(name));
+        fprintf(out, ";%s:%d", name, s->frames[i].line);
+    }
+    fprintf(out, " %lu\n", count);
+}
+
+
+int
+caio_sampler_dump(FILE *out) {
+    size_t i;
+    size_t count;
+    unsigned long same = 0;
+    sigset_t set;
+    sigset_t old;
+
+    /* The handler must not write while the samples are being sorted */
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+
+    count = _count;
+
+    /* Sorting brings the identical stacks together */
+    qsort(_samples, count, sizeof(struct sample), _samplecmp);
+    for (i = 0; i < count; i++) {
+        same++;
+        if (((i + 1) < count) &&
+                (_samplecmp(_samples + i, _samples + i + 1) == 0)) {
+            continue;
+        }
+
+        _print(out, _samples + i, same);
+        same = 0;
+    }
+
+    if (_dropped) {
+        fprintf(out, "caio_loop;[dropped] %lu\n", _dropped);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return fflush(out);
+}
@@ -0,0 +1,72 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_SAMPLER_H_
+#define CAIO_SAMPLER_H_
+
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "caio/caio.h"
+
+
+/* Maximum recorded frames per sample, deeper chains are truncated from the
+ * root side. */
+#ifndef CAIO_SAMPLER_DEPTH
+#define CAIO_SAMPLER_DEPTH 16
+#endif
+
+
+/* The task being stepped by the loop of this thread, maintained by the
+ * caio_loop. */
+extern __thread struct caio_task * volatile caio_sampler_task;
+
+
+/* Start sampling the cpu time of the calling thread, which must be the one
+ * running the loop, hz times per second of its cpu time. On each SIGPROF
+ * the frame chain of the running task is copied into a preallocated buffer
+ * of capacity samples; samples taken outside of any task are accounted to
+ * the loop itself. Only one thread can be sampled at a time. */
+int
+caio_sampler_start(unsigned int hz, size_t capacity);
+
+
+int
+caio_sampler_stop();
+
+
+/* Write the samples as folded stacks, one "root;...;leaf count" per line,
+ * the input format of flamegraph.pl and most flame graph viewers. Frames
+ * are named function:line, the line of the await for callers and the
+ * last resume point for the leaf. */
+int
+caio_sampler_dump(FILE *out);
+
+
+void
+caio_sampler_reset();
+
+
+/* True, once, if a sampling signal has been caught since the last call.
+ * Used by the loop to ignore the EINTR caused by the sampler. */
+bool
+caio_sampler_interrupted();
+
+
+#endif  // CAIO_SAMPLER_H_
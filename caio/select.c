@@ -22,6 +22,12 @@
 #include <string.h>
 
 #include "caio/select.h"
+#include "caio/trace.h"
+#include "caio/probes.h"
+
+#ifdef CAIO_STATS
+#include "caio/stats.h"
+#endif
 
 
 #define FILEEVENT_RESET(fe) \
@@ -55,6 +61,7 @@ _tick(struct caio_select *s, struct caio* c) {
     int shift;
     struct caio_fileevent *fe;
     struct timeval tv;
+    unsigned long long timeout;
     fd_set rfds;
     fd_set wfds;
     fd_set efds;
@@ -63,8 +70,18 @@ _tick(struct caio_select *s, struct caio* c) {
         return 0;
     }
 
-    tv.tv_usec = s->timeout_us % 1000000;
-    tv.tv_sec = s->timeout_us / 1000000;
+    /* Polls without blocking when a task is runnable, and never blocks
+     * longer than caio_loop_once allows, rounded up. */
+    timeout = caio_waitlimit(c);
+    if (timeout < (s->timeout_us * 1000ULL)) {
+        timeout = (timeout + 999) / 1000;
+        tv.tv_usec = timeout % 1000000;
+        tv.tv_sec = timeout / 1000000;
+    }
+    else {
+        tv.tv_usec = s->timeout_us % 1000000;
+        tv.tv_sec = s->timeout_us / 1000000;
+    }
 
     FD_ZERO(&rfds);
     FD_ZERO(&wfds);
@@ -91,7 +108,16 @@ _tick(struct caio_select *s, struct caio* c) {
         }
     }
 
+    CAIO_PROBE2(wait_begin, s, s->waitingfiles);
+#ifdef CAIO_STATS
+    unsigned long long ts = caio_stats_clock();
     nfds = select(s->maxfileno + 1, &rfds, &wfds, &efds, &tv);
+    s->iostats.waitns += caio_stats_clock() - ts;
+    s->iostats.waits++;
+#else
+    nfds = select(s->maxfileno + 1, &rfds, &wfds, &efds, &tv);
+#endif
+    CAIO_PROBE2(wait_end, s, nfds);
     if (nfds == -1) {
         return -1;
     }
@@ -110,7 +136,8 @@ _tick(struct caio_select *s, struct caio* c) {
                 || FD_ISSET(fd, &wfds)
                 || FD_ISSET(fd, &efds)) {
             if (fe->task && (fe->task->status == CAIO_WAITING)) {
-                fe->task->status = CAIO_RUNNING;
+                CAIO_TRACE_EVENT(WAKE, fe->task, fd, 0);
+                caio_task_wake(fe->task, CAIO_RUNNING);
                 s->waitingfiles--;
                 FILEEVENT_RESET(fe);
             }
@@ -126,6 +153,10 @@ _tick(struct caio_select *s, struct caio* c) {
         FILEEVENT_RESET(fe);
     }
     s->eventscount = s->waitingfiles;
+#ifdef CAIO_STATS
+    s->iostats.events += nfds;
+    s->iostats.waitingfiles = s->waitingfiles;
+#endif
     return 0;
 }
 
@@ -133,12 +164,19 @@ _tick(struct caio_select *s, struct caio* c) {
 static int
 _monitor(struct caio_select *s, struct caio_task *task, int fd, int events) {
     struct caio_fileevent *fe;
+
+    CAIO_TRACE_EVENT(AWAIT, task, fd, events);
+    CAIO_PROBE3(file_await, task, fd, events);
     if ((fd < 0) || (fd > s->maxfileno) || (s->eventscount == s->maxfileno)) {
         return -1;
     }
 
     fe = &s->events[s->eventscount++];
     s->waitingfiles++;
+#ifdef CAIO_STATS
+    s->iostats.ctls++;
+    s->iostats.waitingfiles = s->waitingfiles;
+#endif
     fe->events = events;
     fe->task = task;
     fe->fd = fd;
@@ -151,11 +189,15 @@ _forget(struct caio_select *s, int fd) {
     int i;
     struct caio_fileevent *fe;
 
+    CAIO_PROBE1(file_forget, fd);
     for (i = 0; i < s->eventscount; i++) {
         fe = &s->events[i];
         if (fe->fd == fd) {
             FILEEVENT_RESET(fe);
             s->waitingfiles--;
+#ifdef CAIO_STATS
+            s->iostats.ctls++;
+#endif
             return 0;
         }
     }
@@ -0,0 +1,626 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "caio/sim.h"
+#include "caio/trace.h"
+#include "caio/probes.h"
+
+
+struct caio_simfile {
+    bool used;
+    bool alarm;
+
+    /* Index of the other end, -1 when it's closed */
+    int peer;
+
+    /* The alarm's deadline, or when the buffered bytes become readable */
+    unsigned long long readyat;
+
+    /* Inbound bytes */
+    char *buff;
+    size_t capacity;
+    size_t head;
+    size_t len;
+
+    /* Waiter */
+    struct caio_task *task;
+    int events;
+};
+
+
+struct caio_sim {
+    struct caio_iomodule;
+    unsigned long long now;
+    unsigned long long random;
+    struct caio_simfaults faults;
+    size_t waitingfiles;
+    size_t maxfiles;
+    size_t hint;
+    struct caio_simfile *files;
+};
+
+
+#define FILENO(s, f) (CAIO_SIM_FILENO + (int)((f) - (s)->files))
+
+
+static bool
+_chance(struct caio_sim *s, double probability) {
+    if (probability <= 0) {
+        return false;
+    }
+
+    return (caio_sim_random(s) >> 11) * 0x1.0p-53 < probability;
+}
+
+
+static struct caio_simfile *
+_file(struct caio_sim *s, int fd) {
+    struct caio_simfile *f;
+
+    if ((fd < CAIO_SIM_FILENO) || (fd >= (CAIO_SIM_FILENO + s->maxfiles))) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    f = &s->files[fd - CAIO_SIM_FILENO];
+    if (!f->used) {
+        errno = EBADF;
+        return NULL;
+    }
+
+    return f;
+}
+
+
+static struct caio_simfile *
+_file_new(struct caio_sim *s, size_t capacity) {
+    size_t i;
+    struct caio_simfile *f;
+
+    for (i = 0; i < s->maxfiles; i++) {
+        f = &s->files[(s->hint + i) % s->maxfiles];
+        if (f->used) {
+            continue;
+        }
+
+        memset(f, 0, sizeof(struct caio_simfile));
+        if (capacity) {
+            f->buff = malloc(capacity);
+            if (f->buff == NULL) {
+                return NULL;
+            }
+            f->capacity = capacity;
+        }
+
+        f->used = true;
+        f->peer = -1;
+        s->hint = (s->hint + i + 1) % s->maxfiles;
+        return f;
+    }
+
+    errno = EMFILE;
+    return NULL;
+}
+
+
+static void
+_file_release(struct caio_sim *s, struct caio_simfile *f) {
+    if (f->task) {
+        s->waitingfiles--;
+    }
+
+    if (f->peer != -1) {
+        s->files[f->peer].peer = -1;
+    }
+
+    if (f->buff) {
+        free(f->buff);
+    }
+
+    memset(f, 0, sizeof(struct caio_simfile));
+}
+
+
+/* Updates next with the time the file becomes ready if it's not ready
+ * yet. */
+static bool
+_ready(struct caio_sim *s, struct caio_simfile *f, unsigned long long *next) {
+    struct caio_simfile *peer;
+
+    if (f->alarm || ((f->events & CAIO_IN) && f->len)) {
+        if (f->readyat <= s->now) {
+            return true;
+        }
+
+        if (f->readyat < *next) {
+            *next = f->readyat;
+        }
+        return false;
+    }
+
+    /* Hang up */
+    if (f->peer == -1) {
+        return true;
+    }
+
+    if (f->events & CAIO_OUT) {
+        peer = &s->files[f->peer];
+        return peer->len < peer->capacity;
+    }
+
+    return false;
+}
+
+
+static void
+_wakeup(struct caio_sim *s, struct caio_simfile *f) {
+    struct caio_task *task = f->task;
+
+    f->task = NULL;
+    s->waitingfiles--;
+    if (task->status == CAIO_WAITING) {
+        CAIO_TRACE_EVENT(WAKE, task, FILENO(s, f), 0);
+        caio_task_wake(task, CAIO_RUNNING);
+    }
+
+#ifdef CAIO_STATS
+    s->iostats.events++;
+#endif
+    if (f->alarm) {
+        _file_release(s, f);
+    }
+}
+
+
+/* The waiter was killed or awaits another file since, a killed task's slot
+ * may already be leased to another task. */
+static bool
+_stale(struct caio_sim *s, struct caio_simfile *f) {
+    return (f->task->status != CAIO_WAITING) ||
+        (f->task->fd != FILENO(s, f));
+}
+
+
+static void
+_drop(struct caio_sim *s, struct caio_simfile *f) {
+    if (f->alarm) {
+        _file_release(s, f);
+        return;
+    }
+
+    f->task = NULL;
+    s->waitingfiles--;
+}
+
+
+static size_t
+_wake(struct caio_sim *s, unsigned long long *next) {
+    size_t i;
+    size_t woken = 0;
+    size_t deferred = 0;
+    struct caio_simfile *f;
+    struct caio_simfile *chosen = NULL;
+
+    *next = ULLONG_MAX;
+    for (i = 0; i < s->maxfiles; i++) {
+        f = &s->files[i];
+        if (f->task == NULL) {
+            continue;
+        }
+
+        if (_stale(s, f)) {
+            _drop(s, f);
+            continue;
+        }
+
+        if (!_ready(s, f, next)) {
+            continue;
+        }
+
+        if (_chance(s, s->faults.defer)) {
+            /* Keep a random one of the deferred files */
+            if ((caio_sim_random(s) % ++deferred) == 0) {
+                chosen = f;
+            }
+            continue;
+        }
+
+        _wakeup(s, f);
+        woken++;
+    }
+
+    if ((woken == 0) && chosen) {
+        _wakeup(s, chosen);
+        woken++;
+    }
+
+    return woken;
+}
+
+
+static int
+_tick(struct caio_sim *s, struct caio* c) {
+    unsigned long long next;
+
+    if (s->waitingfiles == 0) {
+        return 0;
+    }
+
+#ifdef CAIO_STATS
+    s->iostats.waits++;
+#endif
+    CAIO_PROBE2(wait_begin, s, s->waitingfiles);
+    if (_wake(s, &next) || caio_runnable(c)) {
+        goto done;
+    }
+
+    /* Nothing to do until the next readiness, jump there */
+    if (next == ULLONG_MAX) {
+        errno = EDEADLK;
+        return -1;
+    }
+
+    s->now = next;
+    _wake(s, &next);
+
+done:
+    CAIO_PROBE2(wait_end, s, 0);
+#ifdef CAIO_STATS
+    s->iostats.waitingfiles = s->waitingfiles;
+#endif
+    return 0;
+}
+
+
+static int
+_monitor(struct caio_sim *s, struct caio_task *task, int fd, int events) {
+    struct caio_simfile *f;
+
+    CAIO_TRACE_EVENT(AWAIT, task, fd, events);
+    CAIO_PROBE3(file_await, task, fd, events);
+    f = _file(s, fd);
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (f->task == NULL) {
+        s->waitingfiles++;
+    }
+    f->task = task;
+    f->events = events;
+#ifdef CAIO_STATS
+    s->iostats.ctls++;
+    s->iostats.waitingfiles = s->waitingfiles;
+#endif
+    return 0;
+}
+
+
+static int
+_forget(struct caio_sim *s, int fd) {
+    struct caio_simfile *f;
+
+    CAIO_PROBE1(file_forget, fd);
+    f = _file(s, fd);
+    if (f == NULL) {
+        return -1;
+    }
+
+#ifdef CAIO_STATS
+    s->iostats.ctls++;
+#endif
+    if (f->alarm) {
+        _file_release(s, f);
+    }
+    else if (f->task) {
+        f->task = NULL;
+        s->waitingfiles--;
+    }
+
+    return 0;
+}
+
+
+unsigned long long
+caio_sim_now(struct caio_sim *s) {
+    return s->now;
+}
+
+
+/* xorshift64* */
+unsigned long long
+caio_sim_random(struct caio_sim *s) {
+    unsigned long long x = s->random;
+
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    s->random = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+int
+caio_sim_faults(struct caio_sim *s, const struct caio_simfaults *faults) {
+    if ((s == NULL) || (faults == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    s->faults = *faults;
+    return 0;
+}
+
+
+int
+caio_sim_socketpair(struct caio_sim *s, size_t capacity, int fds[2]) {
+    struct caio_simfile *a;
+    struct caio_simfile *b;
+
+    if (capacity == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    a = _file_new(s, capacity);
+    if (a == NULL) {
+        return -1;
+    }
+
+    b = _file_new(s, capacity);
+    if (b == NULL) {
+        _file_release(s, a);
+        return -1;
+    }
+
+    a->peer = b - s->files;
+    b->peer = a - s->files;
+    fds[0] = FILENO(s, a);
+    fds[1] = FILENO(s, b);
+    return 0;
+}
+
+
+int
+caio_sim_alarm(struct caio_sim *s, unsigned long long ns) {
+    struct caio_simfile *f;
+
+    f = _file_new(s, 0);
+    if (f == NULL) {
+        return -1;
+    }
+
+    f->alarm = true;
+    f->readyat = s->now + ns;
+    return FILENO(s, f);
+}
+
+
+int
+caio_sim_sleep(struct caio_sim *s, struct caio_task *task,
+        unsigned long long ns) {
+    int fd;
+
+    fd = caio_sim_alarm(s, ns);
+    if (fd == -1) {
+        return -1;
+    }
+
+    task->fd = fd;
+    task->events = CAIO_IN;
+    if (_monitor(s, task, fd, CAIO_IN)) {
+        caio_sim_close(s, fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+ssize_t
+caio_sim_read(struct caio_sim *s, int fd, void *buff, size_t size) {
+    size_t n;
+    size_t chunk;
+    struct caio_simfile *f = _file(s, fd);
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (f->alarm) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (f->len && (f->readyat > s->now)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (f->len == 0) {
+        if (f->peer == -1) {
+            return 0;
+        }
+
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if (_chance(s, s->faults.eagain)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    n = size < f->len ? size : f->len;
+    chunk = f->capacity - f->head;
+    if (chunk > n) {
+        chunk = n;
+    }
+    memcpy(buff, f->buff + f->head, chunk);
+    memcpy((char *)buff + chunk, f->buff, n - chunk);
+    f->head = (f->head + n) % f->capacity;
+    f->len -= n;
+    return n;
+}
+
+
+ssize_t
+caio_sim_write(struct caio_sim *s, int fd, const void *buff, size_t size) {
+    size_t n;
+    size_t tail;
+    size_t chunk;
+    unsigned long long readyat;
+    struct caio_simfile *peer;
+    struct caio_simfile *f = _file(s, fd);
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    if (f->alarm) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (f->peer == -1) {
+        errno = EPIPE;
+        return -1;
+    }
+
+    peer = &s->files[f->peer];
+    if ((peer->len == peer->capacity) || _chance(s, s->faults.eagain)) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    n = peer->capacity - peer->len;
+    if (size < n) {
+        n = size;
+    }
+
+    if ((n > 1) && _chance(s, s->faults.partial)) {
+        n = 1 + caio_sim_random(s) % (n - 1);
+    }
+
+    tail = (peer->head + peer->len) % peer->capacity;
+    chunk = peer->capacity - tail;
+    if (chunk > n) {
+        chunk = n;
+    }
+    memcpy(peer->buff + tail, buff, chunk);
+    memcpy(peer->buff, (const char *)buff + chunk, n - chunk);
+    peer->len += n;
+
+    if (s->faults.maxdelay_ns && _chance(s, s->faults.delay)) {
+        readyat = s->now + 1 + caio_sim_random(s) % s->faults.maxdelay_ns;
+        if (readyat > peer->readyat) {
+            peer->readyat = readyat;
+        }
+    }
+
+    return n;
+}
+
+
+int
+caio_sim_close(struct caio_sim *s, int fd) {
+    struct caio_simfile *f = _file(s, fd);
+
+    if (f == NULL) {
+        return -1;
+    }
+
+    _file_release(s, f);
+    return 0;
+}
+
+
+struct caio_sim *
+caio_sim_create(struct caio *c, size_t maxfiles, unsigned long long seed) {
+    struct caio_sim *s;
+
+    if ((maxfiles == 0) || (maxfiles > (INT_MAX - CAIO_SIM_FILENO))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    s = malloc(sizeof(struct caio_sim));
+    if (s == NULL) {
+        return NULL;
+    }
+    memset(s, 0, sizeof(struct caio_sim));
+
+    /* splitmix64 of the seed, xorshift must not start from zero */
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31;
+    s->random = seed ? seed : 1;
+
+    s->maxfiles = maxfiles;
+    s->files = calloc(maxfiles, sizeof(struct caio_simfile));
+    if (s->files == NULL) {
+        goto failed;
+    }
+
+    s->tick = (caio_hook) _tick;
+    s->monitor = (caio_filemonitor)_monitor;
+    s->forget = (caio_fileforget)_forget;
+
+    if (caio_module_install(c, (struct caio_module*)s)) {
+        goto failed;
+    }
+
+    return s;
+
+failed:
+    if (s->files) {
+        free(s->files);
+    }
+
+    free(s);
+    return NULL;
+}
+
+
+int
+caio_sim_destroy(struct caio *c, struct caio_sim *s) {
+    size_t i;
+    int ret = 0;
+
+    if (s == NULL) {
+        return -1;
+    }
+
+    ret |= caio_module_uninstall(c, (struct caio_module*)s);
+
+    for (i = 0; i < s->maxfiles; i++) {
+        if (s->files[i].buff) {
+            free(s->files[i].buff);
+        }
+    }
+
+    free(s->files);
+    free(s);
+    return ret;
+}
@@ -0,0 +1,143 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_SIM_H_
+#define CAIO_SIM_H_
+
+
+#include <errno.h>
+#include <sys/types.h>
+
+#include "caio/caio.h"
+
+
+/* Deterministic virtual time IO module, for simulations and reproducible
+ * tests of the timeout heavy code.
+ *
+ * Simulated files are in-memory socket pairs and one-shot alarms, their
+ * filenos start from CAIO_SIM_FILENO. Awaiting them with CAIO_FILE_AWAIT
+ * never blocks: whenever no task is runnable, the virtual clock jumps to
+ * the next readiness instead. So, given the same seed, a scenario always
+ * runs the same way and as fast as the cpu allows. The tick fails with
+ * EDEADLK if tasks are waiting for simulated files which will never
+ * become ready.
+ *
+ * The seed drives the injected faults only, tasks are stepped in the
+ * taskpool's order as usual. The defer fault is the one which shuffles
+ * which of the ready tasks run in which iteration.
+ *
+ * The sim should be the only iomodule of the loop, and it's clock the
+ * loop's clock:
+ *
+ *     caio_clock_set(c, (caio_clock)caio_sim_now, sim);
+ */
+#define CAIO_SIM_FILENO 0x40000000
+
+
+struct caio_sim;
+
+
+/* Probabilities are between 0 and 1, all zero by default. */
+struct caio_simfaults {
+    /* caio_sim_read and caio_sim_write fail with EAGAIN although the file
+     * is ready */
+    double eagain;
+
+    /* caio_sim_write accepts fewer bytes than asked */
+    double partial;
+
+    /* The written bytes become readable up to maxdelay_ns later */
+    double delay;
+    unsigned long long maxdelay_ns;
+
+    /* A ready file wakes its task in a later tick, at least one of the
+     * ready files wakes it's task per tick. */
+    double defer;
+};
+
+
+struct caio_sim *
+caio_sim_create(struct caio *c, size_t maxfiles, unsigned long long seed);
+
+
+int
+caio_sim_destroy(struct caio *c, struct caio_sim *s);
+
+
+int
+caio_sim_faults(struct caio_sim *s, const struct caio_simfaults *faults);
+
+
+/* Virtual time in nanoseconds, starts from zero. */
+unsigned long long
+caio_sim_now(struct caio_sim *s);
+
+
+/* The seeded pseudo random generator of the sim, scenarios should use it
+ * instead of rand(3) to stay reproducible. */
+unsigned long long
+caio_sim_random(struct caio_sim *s);
+
+
+/* A connected pair of files with capacity bytes of buffer in each
+ * direction. */
+int
+caio_sim_socketpair(struct caio_sim *s, size_t capacity, int fds[2]);
+
+
+/* A one-shot file which becomes readable after ns of virtual time, and is
+ * closed automatically as soon as it wakes up it's task, is forgotten or
+ * it's task is killed. */
+int
+caio_sim_alarm(struct caio_sim *s, unsigned long long ns);
+
+
+ssize_t
+caio_sim_read(struct caio_sim *s, int fd, void *buff, size_t size);
+
+
+ssize_t
+caio_sim_write(struct caio_sim *s, int fd, const void *buff, size_t size);
+
+
+int
+caio_sim_close(struct caio_sim *s, int fd);
+
+
+/* Creates an alarm and makes the task await it, use CAIO_SIM_SLEEP. */
+int
+caio_sim_sleep(struct caio_sim *s, struct caio_task *task,
+        unsigned long long ns);
+
+
+#define CAIO_SIM_SLEEP(s, task, ns) \
+    do { \
+        (task)->current->line = __LINE__; \
+        if (caio_sim_sleep(s, task, ns)) { \
+            (task)->eno = errno; \
+            (task)->status = CAIO_TERMINATING; \
+        } \
+        else { \
+            (task)->status = CAIO_WAITING; \
+        } \
+        return; \
+        case __LINE__:; \
+    } while (0)
+
+
+#endif  // CAIO_SIM_H_
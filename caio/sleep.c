@@ -32,13 +32,22 @@
 #include "caio/generic.c"
 
 
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_nsleep
+#define CAIO_ARG1 struct caio_iomodule *
+#define CAIO_ARG2 unsigned long long
+#include "caio/generic.c"  // NOLINT
+
+
 int
 caio_sleep_create(caio_sleep_t *sleep) {
     int fd;
     if (sleep == NULL) {
         return -1;
     }
-    fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK);
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     if (fd == -1) {
         return -1;
     }
@@ -58,16 +67,58 @@ caio_sleep_destroy(caio_sleep_t *sleep) {
 }
 
 
+int
+caio_nsleep_create(caio_nsleep_t *sleep) {
+    if (sleep == NULL) {
+        return -1;
+    }
+
+    sleep->spin = 0;
+    sleep->deadline = 0;
+    return caio_sleep_create(&sleep->timer);
+}
+
+
+int
+caio_nsleep_destroy(caio_nsleep_t *sleep) {
+    if (sleep == NULL) {
+        return -1;
+    }
+
+    return caio_sleep_destroy(&sleep->timer);
+}
+
+
+int
+caio_nsleep_spin(caio_nsleep_t *sleep, unsigned long long ns) {
+    if (sleep == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    sleep->spin = ns;
+    return 0;
+}
+
+
 static int
-_settimeout(int fd, time_t miliseconds) {
+_settimeout(int fd, unsigned long long nanoseconds) {
     if (fd == -1) {
         errno = EINVAL;
         return -1;
     }
 
-    struct timespec sec = {miliseconds / 1000, (miliseconds % 1000) * 1000};
+    /* A zero it_value disarms the timer instead */
+    if (nanoseconds == 0) {
+        nanoseconds = 1;
+    }
+
+    struct timespec value = {
+        nanoseconds / 1000000000ULL,
+        nanoseconds % 1000000000ULL
+    };
     struct timespec zero = {0, 0};
-    struct itimerspec spec = {zero, sec};
+    struct itimerspec spec = {zero, value};
     if (timerfd_settime(fd, 0, &spec, NULL) == -1) {
         return -1;
     }
@@ -83,7 +134,7 @@ caio_sleepA(struct caio_task *self, caio_sleep_t *state,
     int fd = *state;
     CAIO_BEGIN(self);
 
-    if (_settimeout(fd, miliseconds)) {
+    if (_settimeout(fd, miliseconds * 1000000ULL)) {
         eno = errno;
         close(fd);
         *state = -1;
@@ -94,3 +145,31 @@ caio_sleepA(struct caio_task *self, caio_sleep_t *state,
     CAIO_FILE_FORGET(iom, fd);
     CAIO_FINALLY(self);
 }
+
+
+ASYNC
+caio_nsleepA(struct caio_task *self, caio_nsleep_t *state,
+        struct caio_iomodule *iom, unsigned long long nanoseconds) {
+    int eno;
+    CAIO_BEGIN(self);
+
+    state->deadline = caio_now(self->caio) + nanoseconds;
+    if (nanoseconds > state->spin) {
+        if (_settimeout(state->timer, nanoseconds - state->spin)) {
+            eno = errno;
+            close(state->timer);
+            state->timer = -1;
+            CAIO_THROW(self, eno);
+        }
+
+        CAIO_FILE_AWAIT(iom, self, state->timer, CAIO_IN);
+        CAIO_FILE_FORGET(iom, state->timer);
+    }
+
+    /* Spin phase, the other tasks keep running meanwhile */
+    while (caio_now(self->caio) < state->deadline) {
+        CAIO_YIELD(self);
+    }
+
+    CAIO_FINALLY(self);
+}
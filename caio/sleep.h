@@ -25,9 +25,21 @@
 #include "caio/caio.h"
 
 
+/* A timerfd(2) on CLOCK_MONOTONIC */
 typedef int caio_sleep_t;
 
 
+/* Nanosecond sleeps. When spin is set, the timer fires that many
+ * nanoseconds earlier and the task yields until the deadline (measured with
+ * caio_now), which gives microsecond accurate wakeups at the cost of the
+ * cpu burnt meanwhile, see caio_nsleep_spin. */
+typedef struct caio_nsleep {
+    caio_sleep_t timer;
+    unsigned long long spin;
+    unsigned long long deadline;
+} caio_nsleep_t;
+
+
 #undef CAIO_ARG1
 #undef CAIO_ARG2
 #undef CAIO_ENTITY
@@ -37,6 +49,15 @@ typedef int caio_sleep_t;
 #include "caio/generic.h"
 
 
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_nsleep
+#define CAIO_ARG1 struct caio_iomodule *
+#define CAIO_ARG2 unsigned long long
+#include "caio/generic.h"  // NOLINT
+
+
 int
 caio_sleep_create(caio_sleep_t *sleep);
 
@@ -45,14 +66,37 @@ int
 caio_sleep_destroy(caio_sleep_t *sleep);
 
 
+int
+caio_nsleep_create(caio_nsleep_t *sleep);
+
+
+int
+caio_nsleep_destroy(caio_nsleep_t *sleep);
+
+
+/* Spin for the last ns of each sleep, zero (default) disables it. */
+int
+caio_nsleep_spin(caio_nsleep_t *sleep, unsigned long long ns);
+
+
 ASYNC
 caio_sleepA(struct caio_task *self, caio_sleep_t *state,
         struct caio_iomodule *iom, time_t miliseconds);
 
 
+ASYNC
+caio_nsleepA(struct caio_task *self, caio_nsleep_t *state,
+        struct caio_iomodule *iom, unsigned long long nanoseconds);
+
+
 #define CAIO_SLEEP(self, state, iom, miliseconds) \
     CAIO_AWAIT(self, caio_sleep, caio_sleepA, state, \
             (struct caio_iomodule*)iom, miliseconds)
 
 
+#define CAIO_NSLEEP(self, state, iom, nanoseconds) \
+    CAIO_AWAIT(self, caio_nsleep, caio_nsleepA, state, \
+            (struct caio_iomodule*)iom, nanoseconds)
+
+
 #endif  // CAIO_SLEEP_H_
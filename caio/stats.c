@@ -0,0 +1,170 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "caio/stats.h"
+
+
+#define STATSPAGE_SIZE ((sizeof(struct caio_statspage) + 4095) & ~4095UL)
+
+
+struct caio_statspage *
+caio_statspage_create(const char *filename) {
+    int fd;
+    size_t size = STATSPAGE_SIZE;
+    struct caio_statspage *page;
+
+    if (filename == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, size)) {
+        close(fd);
+        unlink(filename);
+        return NULL;
+    }
+
+    page = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        unlink(filename);
+        return NULL;
+    }
+
+    memset(page, 0, sizeof(struct caio_statspage));
+    page->size = sizeof(struct caio_stats);
+    page->pid = getpid();
+    __atomic_store_n(&page->magic, CAIO_STATSPAGE_MAGIC, __ATOMIC_RELEASE);
+    return page;
+}
+
+
+int
+caio_statspage_destroy(struct caio_statspage *page, const char *filename) {
+    if (page == NULL) {
+        return -1;
+    }
+
+    munmap(page, STATSPAGE_SIZE);
+    if (filename) {
+        unlink(filename);
+    }
+    return 0;
+}
+
+
+const struct caio_statspage *
+caio_stats_attach(const char *filename) {
+    int fd;
+    const struct caio_statspage *page;
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    page = mmap(NULL, STATSPAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        return NULL;
+    }
+
+    if ((__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) !=
+                CAIO_STATSPAGE_MAGIC) ||
+            (page->size != sizeof(struct caio_stats))) {
+        munmap((void *)page, STATSPAGE_SIZE);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    return page;
+}
+
+
+int
+caio_stats_detach(const struct caio_statspage *page) {
+    if (page == NULL) {
+        return -1;
+    }
+
+    return munmap((void *)page, STATSPAGE_SIZE);
+}
+
+
+int
+caio_stats_requestdump(const char *filename) {
+    int fd;
+    struct caio_statspage *page;
+
+    fd = open(filename, O_RDWR | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+
+    page = mmap(NULL, STATSPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+            0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        return -1;
+    }
+
+    if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) !=
+            CAIO_STATSPAGE_MAGIC) {
+        munmap(page, STATSPAGE_SIZE);
+        errno = EPROTO;
+        return -1;
+    }
+
+    __atomic_fetch_add(&page->dumprequests, 1, __ATOMIC_RELEASE);
+    return munmap(page, STATSPAGE_SIZE);
+}
+
+
+int
+caio_stats_read(const struct caio_statspage *page, struct caio_stats *stats) {
+    uint32_t seq;
+
+    if ((page == NULL) || (stats == NULL)) {
+        return -1;
+    }
+
+    do {
+        seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            continue;
+        }
+
+        memcpy(stats, (const void *)&page->stats, sizeof(struct caio_stats));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) ||
+            (seq != __atomic_load_n(&page->seq, __ATOMIC_RELAXED)));
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_STATS_H_
+#define CAIO_STATS_H_
+
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "caio/caio.h"
+
+
+#define CAIO_STATSPAGE_MAGIC 0x6f696163
+
+
+/* A shared memory page, written by the loop once per tick and protected by
+ * a sequence lock, so readers never block the loop. */
+struct caio_statspage {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t seq;
+    pid_t pid;
+    struct caio_stats stats;
+
+    /* Incremented by the observers to ask for a dump of the tasks */
+    uint32_t dumprequests;
+};
+
+
+/* Create and map the given file (usually under /dev/shm) and publish the
+ * loop's statistics into it on each tick. The file is removed by the
+ * caio_destroy. */
+int
+caio_stats_share(struct caio *c, const char *filename);
+
+
+/* Read-only map of a page shared by another process */
+const struct caio_statspage *
+caio_stats_attach(const char *filename);
+
+
+int
+caio_stats_detach(const struct caio_statspage *page);
+
+
+/* Ask the process sharing this file to dump it's tasks, see the
+ * caio_dump_trigger. */
+int
+caio_stats_requestdump(const char *filename);
+
+
+/* Consistent snapshot of the page without any syscall or lock. */
+int
+caio_stats_read(const struct caio_statspage *page, struct caio_stats *stats);
+
+
+struct caio_statspage *
+caio_statspage_create(const char *filename);
+
+
+int
+caio_statspage_destroy(struct caio_statspage *page, const char *filename);
+
+
+static inline void
+caio_statspage_publish(struct caio_statspage *page,
+        const struct caio_stats *stats) {
+    uint32_t seq = page->seq;
+
+    __atomic_store_n(&page->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&page->stats, stats, sizeof(struct caio_stats));
+    __atomic_store_n(&page->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+
+static inline unsigned long long
+caio_stats_clock() {
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+}
+
+
+#endif  // CAIO_STATS_H_
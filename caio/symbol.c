@@ -0,0 +1,177 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/auxv.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "caio/symbol.h"
+
+
+/* The last mapped object, reports usually resolve many addresses of the
+ * same binary. */
+static struct {
+    char filename[256];
+    void *map;
+    size_t size;
+} _object;
+
+
+static const ElfW(Ehdr) *
+_object_map(const char *filename) {
+    int fd;
+    struct stat st;
+    void *map;
+
+    if (_object.map && (strcmp(_object.filename, filename) == 0)) {
+        return _object.map;
+    }
+
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) || (st.st_size < sizeof(ElfW(Ehdr)))) {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (memcmp(map, ELFMAG, SELFMAG)) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    if (_object.map) {
+        munmap(_object.map, _object.size);
+    }
+
+    _object.map = map;
+    _object.size = st.st_size;
+    strncpy(_object.filename, filename, sizeof(_object.filename) - 1);
+    _object.filename[sizeof(_object.filename) - 1] = '\0';
+    return map;
+}
+
+
+/* Search the .symtab, or the .dynsym if stripped, for the function
+ * containing the given (link time) address. */
+static const char *
+_object_lookup(const ElfW(Ehdr) *ehdr, uintptr_t addr, uintptr_t *start) {
+    int i;
+    int type;
+    size_t j;
+    size_t count;
+    const char *base = (const char *)ehdr;
+    const ElfW(Shdr) *shdrs;
+    const ElfW(Shdr) *symtab = NULL;
+    const ElfW(Shdr) *strtab;
+    const ElfW(Sym) *sym;
+
+    if ((ehdr->e_shoff == 0) ||
+            ((ehdr->e_shoff + ehdr->e_shnum * sizeof(ElfW(Shdr))) >
+             _object.size)) {
+        return NULL;
+    }
+
+    shdrs = (const ElfW(Shdr) *)(base + ehdr->e_shoff);
+    for (type = SHT_SYMTAB; (symtab == NULL) && (type >= 0);
+            type = (type == SHT_SYMTAB)? SHT_DYNSYM: -1) {
+        for (i = 0; i < ehdr->e_shnum; i++) {
+            if (shdrs[i].sh_type == type) {
+                symtab = shdrs + i;
+                break;
+            }
+        }
+    }
+
+    if ((symtab == NULL) || (symtab->sh_link >= ehdr->e_shnum)) {
+        return NULL;
+    }
+
+    strtab = shdrs + symtab->sh_link;
+    sym = (const ElfW(Sym) *)(base + symtab->sh_offset);
+    count = symtab->sh_size / sizeof(ElfW(Sym));
+    for (j = 0; j < count; j++, sym++) {
+        if ((ELF64_ST_TYPE(sym->st_info) != STT_FUNC) ||
+                (sym->st_value == 0)) {
+            continue;
+        }
+
+        if ((addr >= sym->st_value) &&
+                (addr < (sym->st_value + (sym->st_size? sym->st_size: 1)))) {
+            *start = sym->st_value;
+            return base + strtab->sh_offset + sym->st_name;
+        }
+    }
+
+    return NULL;
+}
+
+
+int
+caio_symbol(const void *addr, char *buff, size_t size) {
+    Dl_info info;
+    const char *filename;
+    const char *name;
+    const ElfW(Ehdr) *ehdr;
+    uintptr_t bias;
+    uintptr_t start;
+
+    if (!dladdr(addr, &info) || (info.dli_fbase == NULL)) {
+        return snprintf(buff, size, "%p", addr);
+    }
+
+    /* The dli_fname of the main program is its argv[0] */
+    filename = info.dli_fname;
+    ehdr = info.dli_fbase;
+    if (((uintptr_t)ehdr + ehdr->e_phoff) == getauxval(AT_PHDR)) {
+        filename = "/proc/self/exe";
+    }
+
+    /* Executables are linked at their run time address */
+    bias = (ehdr->e_type == ET_EXEC)? 0: (uintptr_t)info.dli_fbase;
+
+    ehdr = _object_map(filename);
+    if (ehdr) {
+        name = _object_lookup(ehdr, (uintptr_t)addr - bias, &start);
+        if (name && (start == ((uintptr_t)addr - bias))) {
+            return snprintf(buff, size, "%s", name);
+        }
+        else if (name) {
+            return snprintf(buff, size, "%s+0x%lx", name,
+                    (unsigned long)((uintptr_t)addr - bias - start));
+        }
+    }
+
+    return snprintf(buff, size, "%s+0x%lx", info.dli_fname,
+            (unsigned long)((uintptr_t)addr - bias));
+}
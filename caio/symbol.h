@@ -0,0 +1,38 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_SYMBOL_H_
+#define CAIO_SYMBOL_H_
+
+
+#include <stddef.h>
+
+
+/* Write the name of the function containing addr into the buff, with a
+ * "+0x<offset>" suffix if addr is not the entry of that function. Static
+ * functions are looked up in the object's symbol table, so they resolve
+ * as long as the binary is not stripped; otherwise "object+0x<offset>" is
+ * written which can be fed into addr2line(1).
+ *
+ * Returns the same as the snprintf(3). Not thread safe, intended for
+ * building reports. */
+int
+caio_symbol(const void *addr, char *buff, size_t size);
+
+
+#endif  // CAIO_SYMBOL_H_
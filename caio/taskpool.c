@@ -21,17 +21,137 @@
 #include <errno.h>
 
 #include "caio/taskpool.h"
+#include "caio/probes.h"
 
 
 #define TASK_RESET(t, s) \
     (t)->status = s; \
     (t)->caio = NULL; \
     (t)->eno = 0; \
+    (t)->fd = -1; \
+    (t)->events = 0; \
+    (t)->laststep = 0; \
     (t)->current = NULL
 
 
+int
+caio_taskqueue_init(struct caio_taskqueue *q, size_t size,
+        unsigned long long maxwait, enum caio_admissionpolicy policy) {
+    struct caio_pendingcall *calls = NULL;
+
+    if (q == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Only empty queues can be resized */
+    if (q->count) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (size) {
+        calls = calloc(size, sizeof(struct caio_pendingcall));
+        if (calls == NULL) {
+            return -1;
+        }
+    }
+
+    if (q->calls != NULL) {
+        free(q->calls);
+    }
+
+    q->calls = calls;
+    q->size = size;
+    q->head = 0;
+    q->maxwait = maxwait;
+    q->policy = policy;
+    q->cancel = false;
+    return 0;
+}
+
+
+int
+caio_taskqueue_deinit(struct caio_taskqueue *q) {
+    struct caio_basecall *call;
+    struct caio_basecall *parent;
+
+    if (q == NULL) {
+        return -1;
+    }
+
+    /* Never started calls have no parent, but free the chain anyway */
+    while ((call = caio_taskqueue_pop(q, NULL))) {
+        while (call) {
+            parent = call->parent;
+            free(call);
+            call = parent;
+        }
+    }
+
+    while ((call = q->dropped)) {
+        q->dropped = call->parent;
+        free(call);
+    }
+    q->droppedtail = NULL;
+
+    if (q->calls != NULL) {
+        free(q->calls);
+        q->calls = NULL;
+    }
+
+    q->size = 0;
+    return 0;
+}
+
+
+int
+caio_taskqueue_push(struct caio_taskqueue *q, struct caio_basecall *call,
+        unsigned long long now) {
+    struct caio_pendingcall *p;
+
+    if (q->count >= q->size) {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    p = q->calls + ((q->head + q->count) % q->size);
+    p->call = call;
+    p->queued = now;
+    q->count++;
+    q->metrics.queued++;
+    return 0;
+}
+
+
+struct caio_basecall *
+caio_taskqueue_pop(struct caio_taskqueue *q, unsigned long long *queued) {
+    struct caio_pendingcall *p;
+
+    if (q->count == 0) {
+        return NULL;
+    }
+
+    p = q->calls + q->head;
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    if (q->count == 0) {
+        q->cancel = false;
+    }
+
+    if (queued) {
+        *queued = p->queued;
+    }
+    return p->call;
+}
+
+
 int
 caio_taskpool_release(struct caio_taskpool *pool, struct caio_task *task) {
+    struct caio *c;
+    bool cancel;
+    unsigned long long queued;
+
     if (pool == NULL) {
         return -1;
     }
@@ -40,8 +160,43 @@ caio_taskpool_release(struct caio_taskpool *pool, struct caio_task *task) {
         return -1;
     }
 
+    /* Hand the task over to the oldest pending call, the pool's count does
+     * not change. */
+    if (pool->pending.count) {
+        c = task->caio;
+        cancel = pool->pending.cancel;
+        TASK_RESET(task, CAIO_RUNNING);
+        task->caio = c;
+        task->laststep = caio_now(c);
+        task->current = caio_taskqueue_pop(&pool->pending, &queued);
+
+        if (cancel) {
+            task->status = CAIO_TERMINATING;
+            task->eno = ECANCELED;
+            pool->pending.metrics.dropped++;
+        }
+        else {
+            pool->pending.metrics.admitted++;
+#ifdef CAIO_STATS
+            caio_hist_add(&pool->pending.metrics.queuetime,
+                    caio_now(c) - queued);
+#endif
+        }
+#ifdef CAIO_STATS
+        pool->releases++;
+        pool->leases++;
+#endif
+        CAIO_PROBE2(task_release, task, pool->count);
+        CAIO_PROBE2(task_lease, task, pool->count);
+        return 0;
+    }
+
     TASK_RESET(task, CAIO_IDLE);
     pool->count--;
+    CAIO_PROBE2(task_release, task, pool->count);
+#ifdef CAIO_STATS
+    pool->releases++;
+#endif
     return 0;
 }
 
@@ -72,11 +227,18 @@ struct caio_task *
 caio_taskpool_lease(struct caio_taskpool *pool) {
     struct caio_task *task = caio_taskpool_next(pool, NULL, CAIO_IDLE);
     if (task == NULL) {
+#ifdef CAIO_STATS
+        pool->exhausted++;
+#endif
         return NULL;
     }
 
     TASK_RESET(task, CAIO_RUNNING);
     pool->count++;
+    CAIO_PROBE2(task_lease, task, pool->count);
+#ifdef CAIO_STATS
+    pool->leases++;
+#endif
 
     return task;
 }
@@ -110,6 +272,12 @@ caio_taskpool_init(struct caio_taskpool *pool, size_t size) {
 
     pool->count = 0;
     pool->size = size;
+    memset(&pool->pending, 0, sizeof(struct caio_taskqueue));
+#ifdef CAIO_STATS
+    pool->leases = 0;
+    pool->releases = 0;
+    pool->exhausted = 0;
+#endif
     return 0;
 }
 
@@ -120,6 +288,7 @@ caio_taskpool_deinit(struct caio_taskpool *pool) {
         return -1;
     }
 
+    caio_taskqueue_deinit(&pool->pending);
     if (pool->tasks != NULL) {
         free(pool->tasks);
     }
@@ -26,11 +26,41 @@
 #include "caio/caio.h"
 
 
+struct caio_pendingcall {
+    struct caio_basecall *call;
+    unsigned long long queued;
+};
+
+
+/* Ring of the calls waiting for an idle task */
+struct caio_taskqueue {
+    struct caio_pendingcall *calls;
+    size_t size;
+    size_t head;
+    size_t count;
+    unsigned long long maxwait;
+    enum caio_admissionpolicy policy;
+    bool cancel;
+    struct caio_admission metrics;
+
+    /* The calls dropped to make room, to be finalized by the loop outside
+     * the steps, linked through their parent meanwhile */
+    struct caio_basecall *dropped;
+    struct caio_basecall *droppedtail;
+};
+
+
 struct caio_taskpool {
     struct caio_task *tasks;
     struct caio_task *last;
     size_t size;
     size_t count;
+    struct caio_taskqueue pending;
+#ifdef CAIO_STATS
+    unsigned long leases;
+    unsigned long releases;
+    unsigned long exhausted;
+#endif
 };
 
 
@@ -51,8 +81,39 @@ struct caio_task *
 caio_taskpool_lease(struct caio_taskpool *pool);
 
 
+/* Returns the task to the pool, or hands it over to the oldest pending call
+ * if any. */
 int
 caio_taskpool_release(struct caio_taskpool *pool, struct caio_task *task);
 
 
+int
+caio_taskqueue_init(struct caio_taskqueue *q, size_t size,
+        unsigned long long maxwait, enum caio_admissionpolicy policy);
+
+
+int
+caio_taskqueue_deinit(struct caio_taskqueue *q);
+
+
+int
+caio_taskqueue_push(struct caio_taskqueue *q, struct caio_basecall *call,
+        unsigned long long now);
+
+
+struct caio_basecall *
+caio_taskqueue_pop(struct caio_taskqueue *q, unsigned long long *queued);
+
+
+/* The oldest pending call or NULL */
+static inline const struct caio_pendingcall *
+caio_taskqueue_head(const struct caio_taskqueue *q) {
+    if (q->count == 0) {
+        return NULL;
+    }
+
+    return q->calls + q->head;
+}
+
+
 #endif  // CAIO_TASKPOOL_H_
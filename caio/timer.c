@@ -0,0 +1,384 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+
+#include "caio/timer.h"
+
+
+#define NOTSCHEDULED ((size_t)-1)
+
+
+struct caio_timers {
+    struct caio *caio;
+    struct caio_iomodule *iomodule;
+    int fd;
+    bool dispatching;
+    struct caio_task *dispatcher;
+
+    /* The bucket the timerfd is armed for */
+    unsigned long long armed;
+
+    /* Min-heap of the timers by their bucket */
+    struct caio_timer **heap;
+    size_t size;
+    size_t count;
+};
+
+
+typedef struct caio_timers caio_timers_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY caio_timers
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static inline unsigned long long
+_bucket(unsigned long long deadline, unsigned long long slack) {
+    if (slack <= 1) {
+        return deadline;
+    }
+
+    return ((deadline + slack - 1) / slack) * slack;
+}
+
+
+static inline void
+_place(struct caio_timers *timers, struct caio_timer *t, size_t index) {
+    timers->heap[index] = t;
+    t->index = index;
+}
+
+
+static void
+_siftup(struct caio_timers *timers, size_t index) {
+    size_t parent;
+    struct caio_timer *t = timers->heap[index];
+
+    while (index) {
+        parent = (index - 1) / 2;
+        if (timers->heap[parent]->expires <= t->expires) {
+            break;
+        }
+
+        _place(timers, timers->heap[parent], index);
+        index = parent;
+    }
+
+    _place(timers, t, index);
+}
+
+
+static void
+_siftdown(struct caio_timers *timers, size_t index) {
+    size_t child;
+    struct caio_timer *t = timers->heap[index];
+
+    while ((child = index * 2 + 1) < timers->count) {
+        if (((child + 1) < timers->count) &&
+                (timers->heap[child + 1]->expires <
+                 timers->heap[child]->expires)) {
+            child++;
+        }
+
+        if (t->expires <= timers->heap[child]->expires) {
+            break;
+        }
+
+        _place(timers, timers->heap[child], index);
+        index = child;
+    }
+
+    _place(timers, t, index);
+}
+
+
+static void
+_remove(struct caio_timers *timers, struct caio_timer *t) {
+    size_t index = t->index;
+    struct caio_timer *last = timers->heap[--timers->count];
+
+    t->index = NOTSCHEDULED;
+    if (last == t) {
+        return;
+    }
+
+    _place(timers, last, index);
+    if (index && (timers->heap[(index - 1) / 2]->expires > last->expires)) {
+        _siftup(timers, index);
+    }
+    else {
+        _siftdown(timers, index);
+    }
+}
+
+
+/* Rearm the timerfd only if the earliest bucket has changed */
+static int
+_arm(struct caio_timers *timers) {
+    unsigned long long now;
+    unsigned long long expires;
+    unsigned long long timeout;
+    struct itimerspec spec = {{0, 0}, {0, 0}};
+
+    if (timers->count == 0) {
+        return 0;
+    }
+
+    expires = timers->heap[0]->expires;
+    if (expires == timers->armed) {
+        return 0;
+    }
+
+    /* Relative, so it works with any clock behind the caio_now */
+    now = caio_now(timers->caio);
+    timeout = expires > now? expires - now: 1;
+    spec.it_value.tv_sec = timeout / 1000000000ULL;
+    spec.it_value.tv_nsec = timeout % 1000000000ULL;
+    if (timerfd_settime(timers->fd, 0, &spec, NULL)) {
+        return -1;
+    }
+
+    timers->armed = expires;
+    return 0;
+}
+
+
+static void
+_expire(struct caio_timers *timers, unsigned long long now) {
+    struct caio_timer *t;
+
+    while (timers->count && (timers->heap[0]->expires <= now)) {
+        t = timers->heap[0];
+
+        /* Touched meanwhile, move it to it's new bucket */
+        if (t->deadline > now) {
+            t->expires = _bucket(t->deadline, t->slack);
+            _siftdown(timers, 0);
+            continue;
+        }
+
+        _remove(timers, t);
+        t->handler(t, t->arg);
+    }
+}
+
+
+static ASYNC
+_dispatchA(struct caio_task *self, struct caio_timers *timers) {
+    unsigned long long expirations;
+    CAIO_BEGIN(self);
+    timers->dispatcher = self;
+
+    while (timers->count) {
+        if (_arm(timers)) {
+            CAIO_THROW(self, errno);
+        }
+
+        CAIO_FILE_AWAIT(timers->iomodule, self, timers->fd, CAIO_IN);
+        if (read(timers->fd, &expirations, sizeof(expirations)) > 0) {
+            timers->armed = 0;
+        }
+        _expire(timers, caio_now(self->caio));
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(timers->iomodule, timers->fd);
+    timers->dispatcher = NULL;
+    timers->dispatching = false;
+}
+
+
+void
+caio_timer_init(struct caio_timer *t, caio_timer_handler handler,
+        void *arg) {
+    memset(t, 0, sizeof(struct caio_timer));
+    t->index = NOTSCHEDULED;
+    t->handler = handler;
+    t->arg = arg;
+}
+
+
+int
+caio_timer_start(struct caio_timers *timers, struct caio_timer *t,
+        unsigned long long timeout_ns, unsigned long long slack_ns) {
+    if ((timers == NULL) || (t == NULL) || (t->handler == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    t->deadline = caio_now(timers->caio) + timeout_ns;
+    t->slack = slack_ns;
+    t->expires = _bucket(t->deadline, slack_ns);
+
+    if (caio_timer_pending(t)) {
+        _siftup(timers, t->index);
+        _siftdown(timers, t->index);
+    }
+    else {
+        if (timers->count == timers->size) {
+            errno = ENOSPC;
+            return -1;
+        }
+
+        timers->heap[timers->count] = t;
+        t->index = timers->count++;
+        _siftup(timers, t->index);
+    }
+
+    if (!timers->dispatching) {
+        if (caio_timers_spawn(timers->caio, _dispatchA, timers)) {
+            _remove(timers, t);
+            return -1;
+        }
+
+        timers->dispatching = true;
+        return 0;
+    }
+
+    /* An earlier bucket while the dispatcher is waiting */
+    if ((t->index == 0) && (t->expires < timers->armed)) {
+        return _arm(timers);
+    }
+
+    return 0;
+}
+
+
+int
+caio_timer_stop(struct caio_timers *timers, struct caio_timer *t) {
+    struct itimerspec disarm = {{0, 0}, {0, 0}};
+
+    if ((timers == NULL) || (t == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (caio_timer_pending(t)) {
+        _remove(timers, t);
+    }
+
+    if (timers->count || (timers->armed == 0)) {
+        return 0;
+    }
+
+    /* The last one, let the dispatcher exit instead of waiting for it */
+    if (timerfd_settime(timers->fd, 0, &disarm, NULL)) {
+        return -1;
+    }
+
+    timers->armed = 0;
+    if (timers->dispatcher &&
+            (timers->dispatcher->status == CAIO_WAITING)) {
+        caio_task_wake(timers->dispatcher, CAIO_RUNNING);
+    }
+
+    return 0;
+}
+
+
+int
+caio_timer_touch(struct caio_timers *timers, struct caio_timer *t,
+        unsigned long long timeout_ns) {
+    if ((timers == NULL) || (t == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    t->deadline = caio_now(timers->caio) + timeout_ns;
+    return 0;
+}
+
+
+void
+caio_timer_kill(struct caio_timer *t, void *arg) {
+    struct caio_task *task = arg;
+
+    if (task->status & (CAIO_RUNNING | CAIO_WAITING)) {
+        task->eno = ETIMEDOUT;
+        caio_task_wake(task, CAIO_TERMINATING);
+    }
+}
+
+
+struct caio_timers *
+caio_timers_create(struct caio *c, struct caio_iomodule *iom,
+        size_t maxtimers) {
+    struct caio_timers *timers;
+
+    if ((c == NULL) || (iom == NULL) || (maxtimers == 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    timers = malloc(sizeof(struct caio_timers));
+    if (timers == NULL) {
+        return NULL;
+    }
+    memset(timers, 0, sizeof(struct caio_timers));
+
+    timers->caio = c;
+    timers->iomodule = iom;
+    timers->size = maxtimers;
+    timers->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (timers->fd == -1) {
+        goto failed;
+    }
+
+    timers->heap = calloc(maxtimers, sizeof(struct caio_timer *));
+    if (timers->heap == NULL) {
+        goto failed;
+    }
+
+    return timers;
+
+failed:
+    if (timers->fd != -1) {
+        close(timers->fd);
+    }
+
+    free(timers);
+    return NULL;
+}
+
+
+int
+caio_timers_destroy(struct caio_timers *timers) {
+    size_t i;
+
+    if (timers == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < timers->count; i++) {
+        timers->heap[i]->index = NOTSCHEDULED;
+    }
+
+    free(timers->heap);
+    close(timers->fd);
+    free(timers);
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_TIMER_H_
+#define CAIO_TIMER_H_
+
+
+#include <stddef.h>
+
+#include "caio/caio.h"
+
+
+/* Coalescing timers for large populations of timeouts, such as the idle
+ * timeouts of the connections.
+ *
+ * A timer expires within slack nanoseconds after it's deadline: deadlines
+ * are rounded up to the multiples of the slack, and all the timers which
+ * fall into the same bucket are handled at once. All the timers share a
+ * single timerfd, which is only rearmed when the earliest bucket changes.
+ *
+ * The handlers are called from a dispatcher task, which is spawned on
+ * demand and exits when there is no timer left, so the task pool needs one
+ * spare task for it. */
+struct caio_timers;
+struct caio_timer;
+typedef void (*caio_timer_handler) (struct caio_timer *t, void *arg);
+
+
+struct caio_timer {
+    unsigned long long deadline;
+    unsigned long long expires;
+    unsigned long long slack;
+    size_t index;
+    caio_timer_handler handler;
+    void *arg;
+};
+
+
+struct caio_timers *
+caio_timers_create(struct caio *c, struct caio_iomodule *iom,
+        size_t maxtimers);
+
+
+int
+caio_timers_destroy(struct caio_timers *timers);
+
+
+void
+caio_timer_init(struct caio_timer *t, caio_timer_handler handler,
+        void *arg);
+
+
+/* (Re)schedule the timer timeout_ns from now, see caio_now. */
+int
+caio_timer_start(struct caio_timers *timers, struct caio_timer *t,
+        unsigned long long timeout_ns, unsigned long long slack_ns);
+
+
+int
+caio_timer_stop(struct caio_timers *timers, struct caio_timer *t);
+
+
+static inline bool
+caio_timer_pending(const struct caio_timer *t) {
+    return t->index != (size_t)-1;
+}
+
+
+/* Extend a pending timer's deadline to timeout_ns from now in O(1), the
+ * timer is moved to it's new bucket lazily, when the old one expires. Use
+ * caio_timer_start to shorten it instead. */
+int
+caio_timer_touch(struct caio_timers *timers, struct caio_timer *t,
+        unsigned long long timeout_ns);
+
+
+/* Builtin handler, terminates the task given as the arg with ETIMEDOUT. */
+void
+caio_timer_kill(struct caio_timer *t, void *task);
+
+
+#endif  // CAIO_TIMER_H_
@@ -0,0 +1,169 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "caio/trace.h"
+#include "caio/symbol.h"
+
+
+__thread struct caio_tracering *caio_trace_current;
+
+
+static unsigned long long
+_clock() {
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+}
+
+
+struct caio_tracering *
+caio_tracering_create(size_t capacity) {
+    size_t size = 1;
+    struct caio_tracering *ring;
+
+    if (capacity == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ring = malloc(sizeof(struct caio_tracering) +
+            size * sizeof(struct caio_tracerecord));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->startns = _clock();
+    ring->startts = caio_trace_clock();
+    return ring;
+}
+
+
+int
+caio_tracering_destroy(struct caio_tracering *ring) {
+    if (ring == NULL) {
+        return -1;
+    }
+
+    if (caio_trace_current == ring) {
+        caio_trace_current = NULL;
+    }
+
+    free(ring);
+    return 0;
+}
+
+
+static long
+_tid(const void *task, const struct caio_task *tasks, size_t count) {
+    const struct caio_task *t = task;
+
+    if ((t == NULL) || (t < tasks) || (t >= (tasks + count))) {
+        return 0;
+    }
+
+    return (t - tasks) + 1;
+}
+
+
+int
+caio_tracering_dump(struct caio_tracering *ring, FILE *out,
+        const struct caio_task *tasks, size_t count) {
+    uint64_t i;
+    uint64_t first;
+    uint64_t endts;
+    unsigned long long endns;
+    double nsperts;
+    double us;
+    long tid;
+    char name[256];
+    const char *sep = "";
+    const struct caio_tracerecord *r;
+    pid_t pid = getpid();
+
+    if ((ring == NULL) || (out == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Calibrate the clock against the monotonic one */
+    endns = _clock();
+    endts = caio_trace_clock();
+    nsperts = (endts > ring->startts)?
+        (double)(endns - ring->startns) / (endts - ring->startts): 1;
+
+    first = (ring->head > (ring->mask + 1))? ring->head - ring->mask - 1: 0;
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (i = first; i < ring->head; i++) {
+        r = ring->records + (i & ring->mask);
+        us = (r->ts - ring->startts) * nsperts / 1000.0;
+        tid = _tid(r->task, tasks, count);
+
+        fprintf(out, "%s{\"pid\": %d, \"tid\": %ld, \"ts\": %.3f, ", sep, pid,
+                tid, us);
+        sep = ",\n";
+        switch (r->event) {
+            case CAIO_TRACE_SPAWN:
+                fprintf(out, "\"ph\": \"i\", \"s\": \"t\", \"name\": "
+                        "\"spawn\"}");
+                break;
+            case CAIO_TRACE_STEPBEGIN:
+                caio_symbol((const void *)r->arg, name, sizeof(name));
+                fprintf(out, "\"ph\": \"B\", \"name\": \"%s\", "
+                        "\"args\": {\"line\": %d}}", name, r->aux);
+                break;
+            case CAIO_TRACE_STEPEND:
+                fprintf(out, "\"ph\": \"E\", \"args\": {\"status\": %d}}",
+                        r->aux);
+                break;
+            case CAIO_TRACE_AWAIT:
+                fprintf(out, "\"ph\": \"i\", \"s\": \"t\", \"name\": "
+                        "\"await\", \"args\": {\"fd\": %d, \"events\": %d}}",
+                        (int)r->arg, r->aux);
+                break;
+            case CAIO_TRACE_WAKE:
+                fprintf(out, "\"ph\": \"i\", \"s\": \"t\", \"name\": "
+                        "\"wake\", \"args\": {\"fd\": %d}}", (int)r->arg);
+                break;
+            case CAIO_TRACE_TICKBEGIN:
+                fprintf(out, "\"ph\": \"B\", \"name\": \"tick[%d]\"}", r->aux);
+                break;
+            case CAIO_TRACE_TICKEND:
+                fprintf(out, "\"ph\": \"E\"}");
+                break;
+            case CAIO_TRACE_TERMINATE:
+                fprintf(out, "\"ph\": \"i\", \"s\": \"t\", \"name\": "
+                        "\"terminate\", \"args\": {\"eno\": %d}}", r->aux);
+                break;
+            default:
+                fprintf(out, "\"ph\": \"i\", \"s\": \"t\", \"name\": "
+                        "\"unknown\"}");
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+    return fflush(out);
+}
@@ -0,0 +1,143 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ */
+#ifndef CAIO_TRACE_H_
+#define CAIO_TRACE_H_
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "caio/caio.h"
+
+
+enum caio_traceevent {
+    CAIO_TRACE_SPAWN,
+    CAIO_TRACE_STEPBEGIN,
+    CAIO_TRACE_STEPEND,
+    CAIO_TRACE_AWAIT,
+    CAIO_TRACE_WAKE,
+    CAIO_TRACE_TICKBEGIN,
+    CAIO_TRACE_TICKEND,
+    CAIO_TRACE_TERMINATE,
+};
+
+
+/* Fixed size binary record, the meaning of arg and aux depends on the
+ * event:
+ *   stepbegin: coroutine, line
+ *   stepend:   coroutine, status
+ *   await:     fd, events
+ *   wake:      fd or -1 if unknown
+ *   tick*:     module, module index
+ *   terminate: -, eno */
+struct caio_tracerecord {
+    uint64_t ts;
+    const void *task;
+    uint64_t arg;
+    uint32_t event;
+    int32_t aux;
+};
+
+
+struct caio_tracering {
+    size_t mask;
+    uint64_t head;
+    uint64_t startts;
+    unsigned long long startns;
+    struct caio_tracerecord records[];
+};
+
+
+/* The ring of the loop running on this thread, maintained by caio_loop */
+extern __thread struct caio_tracering *caio_trace_current;
+
+
+static inline uint64_t
+caio_trace_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return caio_clock_gettime(CLOCK_MONOTONIC);
+#endif
+}
+
+
+static inline void
+caio_trace_push(struct caio_tracering *ring, enum caio_traceevent event,
+        const void *task, uint64_t arg, int32_t aux) {
+    struct caio_tracerecord *r = ring->records + (ring->head++ & ring->mask);
+
+    r->ts = caio_trace_clock();
+    r->task = task;
+    r->arg = arg;
+    r->event = event;
+    r->aux = aux;
+}
+
+
+#ifdef CAIO_TRACE
+#define CAIO_TRACE_EVENT(event, task, arg, aux) \
+    do { \
+        if (caio_trace_current) { \
+            caio_trace_push(caio_trace_current, CAIO_TRACE_ ## event, task, \
+                    (uint64_t)(arg), aux); \
+        } \
+    } while (0)
+#else
+#define CAIO_TRACE_EVENT(event, task, arg, aux)
+#endif
+
+
+/* Start recording into a ring of at least capacity records, the oldest
+ * records are overwritten. */
+int
+caio_trace_start(struct caio *c, size_t capacity);
+
+
+int
+caio_trace_stop(struct caio *c);
+
+
+/* Write the records in the Chrome trace event JSON format, which can be
+ * opened by chrome://tracing and ui.perfetto.dev. Steps are shown as
+ * slices on one track per task, module ticks on the loop's track. */
+int
+caio_trace_dump(struct caio *c, FILE *out);
+
+
+struct caio_tracering *
+caio_tracering_create(size_t capacity);
+
+
+int
+caio_tracering_destroy(struct caio_tracering *ring);
+
+
+/* Tasks out of the tasks array, i.e. placeholders, go to the loop's
+ * track. */
+int
+caio_tracering_dump(struct caio_tracering *ring, FILE *out,
+        const struct caio_task *tasks, size_t count);
+
+
+#endif  // CAIO_TRACE_H_
@@ -0,0 +1,157 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Request scoped allocations from the task's arena, which are given back
+ * at once at the end of each request.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include <errno.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+
+
+#define WORKERS 3
+
+
+static const char *requests[] = {
+    "GET / HTTP/1.1\r\nHost: example.com\r\nAccept: */*\r\n\r\n",
+    "GET /about HTTP/1.1\r\nHost: example.com\r\nUser-Agent: caio\r\n"
+        "Connection: close\r\n\r\n",
+    "POST /form HTTP/1.1\r\nHost: example.com\r\nContent-Length: 0\r\n\r\n",
+};
+
+
+struct header {
+    const char *name;
+    const char *value;
+    struct header *next;
+};
+
+
+typedef struct worker {
+    int index;
+    int request;
+    struct header *headers;
+} worker_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY worker
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static struct header *
+_parse(struct caio_arena *arena, const char *request) {
+    const char *line;
+    const char *colon;
+    const char *end;
+    struct header *h;
+    struct header *headers = NULL;
+
+    /* Skip the request line */
+    line = strstr(request, "\r\n") + 2;
+    while ((end = strstr(line, "\r\n")) && (end != line)) {
+        colon = memchr(line, ':', end - line);
+        if (colon == NULL) {
+            return NULL;
+        }
+
+        h = caio_arena_alloc(arena, sizeof(struct header));
+        if (h == NULL) {
+            return NULL;
+        }
+
+        h->name = caio_arena_strndup(arena, line, colon - line);
+        h->value = caio_arena_strndup(arena, colon + 2, end - colon - 2);
+        if ((h->name == NULL) || (h->value == NULL)) {
+            return NULL;
+        }
+
+        h->next = headers;
+        headers = h;
+        line = end + 2;
+    }
+
+    return headers;
+}
+
+
+static ASYNC
+workerA(struct caio_task *self, struct worker *state) {
+    struct header *h;
+    CAIO_BEGIN(self);
+
+    for (state->request = 0; state->request < 3; state->request++) {
+        state->headers = _parse(caio_task_arena(self),
+                requests[(state->index + state->request) % 3]);
+        if (state->headers == NULL) {
+            CAIO_THROW(self, errno? errno: EINVAL);
+        }
+
+        /* The headers survive the awaits, till the end of the request */
+        CAIO_YIELD(self);
+
+        for (h = state->headers; h; h = h->next) {
+            printf("worker %d, request %d: %s = %s\n", state->index,
+                    state->request, h->name, h->value);
+        }
+        caio_arena_reset(caio_task_arena(self));
+    }
+
+    CAIO_FINALLY(self);
+    if (CAIO_HASERROR(self)) {
+        warnx("worker %d: %s", state->index, strerror(self->eno));
+    }
+}
+
+
+int
+main() {
+    int i;
+    int exitstatus = EXIT_SUCCESS;
+    struct caio *c;
+    struct worker workers[WORKERS];
+
+    c = caio_create(WORKERS);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < WORKERS; i++) {
+        workers[i].index = i;
+        worker_spawn(c, workerA, &workers[i]);
+    }
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
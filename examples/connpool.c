@@ -0,0 +1,313 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Clients calling a local caio echo server through a connections pool,
+ * with at most two connections to it, which are reused across requests.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/timer.h"
+#include "caio/connpool.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define CLIENTS 4
+#define REQUESTS 5
+#define MAXPERHOST 2
+#define BUFFSIZE 64
+
+
+static struct caio *_caio;
+static struct caio_iomodule *_iomodule;
+static int _clients = CLIENTS;
+
+
+typedef struct listener {
+    int fd;
+} listener_t;
+
+
+typedef struct echo {
+    int fd;
+    char buff[BUFFSIZE];
+} echo_t;
+
+
+typedef struct client {
+    int index;
+    int request;
+    struct sockaddr_in *addr;
+    struct caio_connpool *pool;
+    caio_conn_t conn;
+    char buff[BUFFSIZE];
+    size_t len;
+} client_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY listener
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY echo
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY client
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static ASYNC
+echoA(struct caio_task *self, struct echo *state) {
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        bytes = read(state->fd, state->buff, BUFFSIZE);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(_iomodule, self, state->fd, CAIO_IN);
+            continue;
+        }
+
+        if (bytes <= 0) {
+            break;
+        }
+
+        /* Short replies are fine for this example */
+        if (write(state->fd, state->buff, bytes) != bytes) {
+            CAIO_THROW(self, errno);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(_iomodule, state->fd);
+    close(state->fd);
+    free(state);
+}
+
+
+static ASYNC
+listenerA(struct caio_task *self, struct listener *state) {
+    int fd;
+    struct echo *echo;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        fd = accept4(state->fd, NULL, NULL, SOCK_NONBLOCK);
+        if ((fd == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(_iomodule, self, state->fd, CAIO_IN);
+            continue;
+        }
+
+        if (fd == -1) {
+            CAIO_THROW(self, errno);
+        }
+
+        printf("server: new connection, fd: %d\n", fd);
+        echo = malloc(sizeof(struct echo));
+        if (echo == NULL) {
+            close(fd);
+            continue;
+        }
+
+        echo->fd = fd;
+        if (echo_spawn(_caio, echoA, echo)) {
+            close(fd);
+            free(echo);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(_iomodule, state->fd);
+}
+
+
+static ASYNC
+clientA(struct caio_task *self, struct client *state) {
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    for (state->request = 0; state->request < REQUESTS; state->request++) {
+        CAIO_CONNPOOL_CHECKOUT(self, &state->conn, state->pool, state->addr);
+        if (CAIO_HASERROR(self)) {
+            warnx("client %d: checkout: %s", state->index,
+                    strerror(self->eno));
+            CAIO_RETHROW(self);
+        }
+
+        state->len = snprintf(state->buff, BUFFSIZE, "client %d, request %d",
+                state->index, state->request);
+        if (write(state->conn.fd, state->buff, state->len) != state->len) {
+            CAIO_THROW(self, errno);
+        }
+
+        while (true) {
+            bytes = read(state->conn.fd, state->buff, BUFFSIZE - 1);
+            if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+                CAIO_FILE_AWAIT(_iomodule, self, state->conn.fd, CAIO_IN);
+                continue;
+            }
+
+            if (bytes <= 0) {
+                CAIO_THROW(self, bytes? errno: ECONNRESET);
+            }
+
+            break;
+        }
+
+        state->buff[bytes] = '\0';
+        printf("%s, fd: %d%s\n", state->buff, state->conn.fd,
+                state->conn.reused? ", reused": "");
+        caio_connpool_checkin(&state->conn, true);
+    }
+
+    CAIO_FINALLY(self);
+    if (state->conn.fd != -1) {
+        caio_connpool_checkin(&state->conn, false);
+    }
+
+    /* Stop the server after the last client */
+    if (--_clients == 0) {
+        caio_task_killall(_caio);
+    }
+}
+
+
+int
+main() {
+    int i;
+    int exitstatus = EXIT_SUCCESS;
+    socklen_t addrlen = sizeof(struct sockaddr_in);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr = {htonl(INADDR_LOOPBACK)},
+        .sin_port = 0,
+    };
+    struct listener listener = {.fd = -1};
+    struct client clients[CLIENTS];
+    struct caio_timers *timers = NULL;
+    struct caio_connpool *pool = NULL;
+    struct caio_connpoolstats stats;
+
+    /* The listener, echoes, clients and the timers dispatcher */
+    _caio = caio_create(1 + MAXPERHOST + CLIENTS + 1);
+    if (_caio == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef CAIO_EPOLL
+    _iomodule = (struct caio_iomodule*)caio_epoll_create(_caio,
+            1 + MAXPERHOST * 2, 1000);
+#elif defined(CAIO_SELECT)
+    _iomodule = (struct caio_iomodule*)caio_select_create(_caio, 64,
+            1000000);
+#endif
+    if (_iomodule == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    /* The connect timeouts and the idle reaper of the host */
+    timers = caio_timers_create(_caio, _iomodule, CLIENTS + 1);
+    if (timers == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    pool = caio_connpool_create(_caio, _iomodule, timers, 1, MAXPERHOST);
+    if ((pool == NULL) ||
+            caio_connpool_timeouts(pool, 1000000000ULL, 10000000000ULL)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    /* The echo server, on an ephemeral port */
+    listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if ((listener.fd == -1) ||
+            bind(listener.fd, (struct sockaddr *)&addr, addrlen) ||
+            getsockname(listener.fd, (struct sockaddr *)&addr, &addrlen) ||
+            listen(listener.fd, CLIENTS)) {
+        warn("echo server");
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+    listener_spawn(_caio, listenerA, &listener);
+
+    for (i = 0; i < CLIENTS; i++) {
+        clients[i].index = i;
+        clients[i].addr = &addr;
+        clients[i].pool = pool;
+        clients[i].conn.fd = -1;
+        client_spawn(_caio, clientA, &clients[i]);
+    }
+
+    if (caio_loop(_caio)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    caio_connpool_stats(pool, &stats);
+    printf("connects: %lu, reuses: %lu, stale: %lu, waits: %lu\n",
+            stats.connects, stats.reuses, stats.stale, stats.waits);
+
+terminate:
+    caio_connpool_destroy(pool);
+    caio_timers_destroy(timers);
+    if (listener.fd != -1) {
+        close(listener.fd);
+    }
+
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(_caio, (struct caio_epoll*)_iomodule);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(_caio, (struct caio_select*)_iomodule);
+#endif
+
+    if (caio_destroy(_caio)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
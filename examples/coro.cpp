@@ -0,0 +1,178 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * The C++20 coroutines bridge: a pinger and an echo coroutine over a
+ * socketpair, nested tasks with return values, the caio sleeps and a task
+ * killed while sleeping.
+ */
+#include <sys/socket.h>
+#include <err.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "caio/caio.hpp"
+
+extern "C" {
+#include "caio/epoll.h"
+}
+
+
+#define PINGS 5
+
+
+/* Ticks until the pinger kills it */
+static struct caio_task *ticker_task;
+
+
+static caiopp::task<>
+echo(struct caio_iomodule *iom, int fd) {
+    char buff[64];
+    ssize_t bytes;
+
+    while ((bytes = co_await caiopp::read(iom, fd, buff, sizeof(buff))) > 0) {
+        if (co_await caiopp::write(iom, fd, buff, bytes) != bytes) {
+            warn("echo write");
+            break;
+        }
+    }
+
+    CAIO_FILE_FORGET(iom, fd);
+}
+
+
+/* Round trip time in nanoseconds, or -1 */
+static caiopp::task<long long>
+ping(struct caio *c, struct caio_iomodule *iom, int fd, int seq) {
+    char buff[64];
+    unsigned long long started = caio_now(c);
+    int len = snprintf(buff, sizeof(buff), "ping %d", seq);
+
+    if (co_await caiopp::write(iom, fd, buff, len) != len) {
+        co_return -1;
+    }
+
+    if (co_await caiopp::read(iom, fd, buff, sizeof(buff)) != len) {
+        co_return -1;
+    }
+
+    co_return caio_now(c) - started;
+}
+
+
+static caiopp::task<>
+ticker(struct caio_iomodule *iom) {
+    caio_nsleep_t sleep;
+    int ticks = 0;
+    int eno;
+
+    if (caio_nsleep_create(&sleep)) {
+        co_return;
+    }
+
+    ticker_task = co_await caiopp::this_task();
+    while ((eno = co_await caiopp::sleep(&sleep, iom, 30000000ULL)) == 0) {
+        ticks++;
+    }
+
+    printf("ticker: %s after %d ticks\n", strerror(eno), ticks);
+    ticker_task = NULL;
+    caio_nsleep_destroy(&sleep);
+}
+
+
+static caiopp::task<>
+pinger(struct caio *c, struct caio_iomodule *iom, int fd) {
+    caio_nsleep_t sleep;
+    long long rtt;
+    int i;
+
+    if (caio_nsleep_create(&sleep)) {
+        co_return;
+    }
+
+    for (i = 0; i < PINGS; i++) {
+        rtt = co_await ping(c, iom, fd, i);
+        printf("ping %d, rtt: %lldns\n", i, rtt);
+
+        if (co_await caiopp::sleep(&sleep, iom, 100000000ULL)) {
+            warnx("sleep");
+            break;
+        }
+    }
+
+    caio_nsleep_destroy(&sleep);
+    CAIO_FILE_FORGET(iom, fd);
+    shutdown(fd, SHUT_WR);
+
+    if (ticker_task) {
+        caio_task_wake(ticker_task, CAIO_TERMINATING);
+    }
+}
+
+
+int
+main() {
+    int exitstatus = EXIT_SUCCESS;
+    int fds[2];
+    struct caio *c;
+    struct caio_epoll *epoll;
+    struct caio_iomodule *iom;
+
+    c = caio_create(3);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    epoll = caio_epoll_create(c, 3, 1000);
+    if (epoll == NULL) {
+        caio_destroy(c);
+        return EXIT_FAILURE;
+    }
+    iom = (struct caio_iomodule*)epoll;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    if (caiopp::spawn(c, echo(iom, fds[1])) ||
+            caiopp::spawn(c, ticker(iom)) ||
+            caiopp::spawn(c, pinger(c, iom, fds[0]))) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+terminate:
+    caio_epoll_destroy(c, epoll);
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    caiopp::framepool::trim();
+    return exitstatus;
+}
@@ -0,0 +1,138 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Nest caio into a host poll(2) loop using the epoll fd, stepping it only
+ * when it has work, instead of handing caio_loop a thread of it's own.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <err.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/sleep.h"
+#include "caio/epoll.h"
+
+
+#define WORKERS 4
+
+
+typedef struct worker {
+    int index;
+    int count;
+    caio_sleep_t sleep;
+    struct caio_iomodule *iomodule;
+} worker_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY worker
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static ASYNC
+workerA(struct caio_task *self, struct worker *state) {
+    CAIO_BEGIN(self);
+    while (state->count--) {
+        CAIO_SLEEP(self, &state->sleep, state->iomodule,
+                100 * (state->index + 1));
+        printf("worker %d: %d left\n", state->index, state->count);
+    }
+    CAIO_FINALLY(self);
+}
+
+
+int
+main() {
+    int i;
+    int ret;
+    int exitstatus = EXIT_SUCCESS;
+    unsigned long hostwakeups = 0;
+    unsigned long steps = 0;
+    struct caio *c;
+    struct caio_epoll *epoll = NULL;
+    struct worker workers[WORKERS];
+    struct pollfd pfd;
+
+    c = caio_create(WORKERS);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    epoll = caio_epoll_create(c, WORKERS, 1000);
+    if (epoll == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    pfd.fd = caio_iomodule_fileno((struct caio_iomodule*)epoll);
+    pfd.events = POLLIN;
+    if (pfd.fd == -1) {
+        warn("caio_iomodule_fileno");
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    for (i = 0; i < WORKERS; i++) {
+        workers[i].index = i;
+        workers[i].count = 3;
+        workers[i].iomodule = (struct caio_iomodule*)epoll;
+        caio_sleep_create(&workers[i].sleep);
+        worker_spawn(c, workerA, &workers[i]);
+    }
+
+    /* Give caio a time slice first */
+    ret = caio_loop_run_for(c, 250000000ULL);
+    printf("run_for: %d tasks remaining\n", ret);
+
+    /* Then only step it when it's fd is readable, or a task is runnable */
+    while (ret > 0) {
+        if (poll(&pfd, 1, caio_runnable(c)? 0: 1000) == -1) {
+            warn("poll");
+            exitstatus = EXIT_FAILURE;
+            break;
+        }
+        hostwakeups++;
+
+        ret = caio_loop_once(c, 0);
+        steps++;
+    }
+
+    if (ret == -1) {
+        exitstatus = EXIT_FAILURE;
+    }
+    printf("host wakeups: %lu, caio steps: %lu\n", hostwakeups, steps);
+
+    for (i = 0; i < WORKERS; i++) {
+        caio_sleep_destroy(&workers[i].sleep);
+    }
+
+terminate:
+    caio_epoll_destroy(c, epoll);
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
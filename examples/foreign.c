@@ -0,0 +1,209 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Host a callback driven library on the caio loop, next to the caio tasks,
+ * without a side thread.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/socket.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/timer.h"
+#include "caio/foreign.h"
+#include "caio/epoll.h"
+
+
+#define PINGS 5
+#define INTERVAL 100000000LL
+
+
+/* A stand in for a third-party library, like libcurl's multi interface: it
+ * asks it's host to watch it's socket and to set a single timer, and pings
+ * the other end of a socketpair every INTERVAL. */
+struct pinger {
+    int fd;
+    int pings;
+    int pongs;
+    struct caio_foreign *host;
+};
+
+
+static void
+_pong(int fd, int events, void *arg) {
+    struct pinger *p = arg;
+    char buff[8];
+
+    if (read(fd, buff, sizeof(buff)) <= 0) {
+        warn("pinger read");
+        caio_foreign_watch(p->host, fd, 0, NULL, NULL);
+        return;
+    }
+
+    printf("pinger: pong %d\n", ++p->pongs);
+    if (p->pongs == PINGS) {
+        caio_foreign_watch(p->host, fd, 0, NULL, NULL);
+        shutdown(fd, SHUT_WR);
+    }
+}
+
+
+static void
+_ping(void *arg) {
+    struct pinger *p = arg;
+
+    if (write(p->fd, "ping", 4) != 4) {
+        warn("pinger write");
+        return;
+    }
+
+    printf("pinger: ping %d\n", ++p->pings);
+    if (p->pings < PINGS) {
+        caio_foreign_timer(p->host, INTERVAL, _ping, p);
+    }
+}
+
+
+/* The caio side, echoes until the pinger shuts it's socket down */
+typedef struct echo {
+    int fd;
+    struct caio_iomodule *iomodule;
+} echo_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY echo
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static ASYNC
+echoA(struct caio_task *self, struct echo *state) {
+    ssize_t bytes;
+    char buff[8];
+    CAIO_BEGIN(self);
+
+    while (true) {
+        bytes = read(state->fd, buff, sizeof(buff));
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(state->iomodule, self, state->fd, CAIO_IN);
+            continue;
+        }
+
+        if (bytes <= 0) {
+            break;
+        }
+
+        if (write(state->fd, "pong", 4) != 4) {
+            CAIO_THROW(self, errno);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(state->iomodule, state->fd);
+}
+
+
+int
+main() {
+    int exitstatus = EXIT_SUCCESS;
+    int fds[2] = {-1, -1};
+    struct caio *c;
+    struct caio_epoll *epoll = NULL;
+    struct caio_timers *timers = NULL;
+    struct caio_foreign *foreign = NULL;
+    struct pinger pinger = {0};
+    struct echo echo;
+
+    /* The echo and the timers dispatcher */
+    c = caio_create(2);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    epoll = caio_epoll_create(c, 4, 1000);
+    if (epoll == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    timers = caio_timers_create(c, (struct caio_iomodule*)epoll, 1);
+    if (timers == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    foreign = caio_foreign_create(c, (struct caio_iomodule*)epoll, timers,
+            64);
+    if (foreign == NULL) {
+        warn("caio_foreign_create");
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    /* What the library's socket and timer callbacks would do */
+    pinger.fd = fds[0];
+    pinger.host = foreign;
+    if (caio_foreign_watch(foreign, pinger.fd, CAIO_IN, _pong, &pinger) ||
+            caio_foreign_timer(foreign, 0, _ping, &pinger)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    echo.fd = fds[1];
+    echo.iomodule = (struct caio_iomodule*)epoll;
+    echo_spawn(c, echoA, &echo);
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    printf("pings: %d, pongs: %d\n", pinger.pings, pinger.pongs);
+    if (pinger.pongs != PINGS) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+terminate:
+    caio_foreign_destroy(foreign);
+    caio_timers_destroy(timers);
+    caio_epoll_destroy(c, epoll);
+
+    if (fds[0] != -1) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
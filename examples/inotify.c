@@ -0,0 +1,191 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Watch a file for modifications while another coroutine writes to it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/sleep.h"
+#include "caio/inotify.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define FILENAME "/tmp/caio-inotify-example"
+
+
+typedef struct watcher {
+    const char *path;
+    struct caio_inotify *inotify;
+    struct caio_inotify_event event;
+} watcher_t;
+
+
+typedef struct writer {
+    const char *path;
+    int count;
+    caio_sleep_t sleep;
+    struct caio_iomodule *iomodule;
+} writer_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY watcher
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY writer
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static ASYNC
+watcherA(struct caio_task *self, struct watcher *state) {
+    CAIO_BEGIN(self);
+
+    while (true) {
+        CAIO_WATCH_AWAIT(state->inotify, self, state->path,
+                IN_MODIFY | IN_DELETE_SELF, &state->event);
+        printf("%s: mask: 0x%x\n", state->path, state->event.mask);
+        if (state->event.mask & (IN_DELETE_SELF | IN_IGNORED)) {
+            break;
+        }
+    }
+
+    CAIO_FINALLY(self);
+    if (CAIO_HASERROR(self)) {
+        warnx("watch: %s: %s", state->path, strerror(self->eno));
+    }
+    CAIO_WATCH_FORGET(state->inotify, self);
+}
+
+
+static ASYNC
+writerA(struct caio_task *self, struct writer *state) {
+    int fd;
+    CAIO_BEGIN(self);
+
+    while (state->count--) {
+        CAIO_SLEEP(self, &state->sleep, state->iomodule, 300);
+        fd = open(state->path, O_WRONLY | O_APPEND);
+        if (fd == -1) {
+            CAIO_THROW(self, errno);
+        }
+
+        if (write(fd, "foo\n", 4) != 4) {
+            close(fd);
+            CAIO_THROW(self, errno);
+        }
+        close(fd);
+    }
+
+    CAIO_SLEEP(self, &state->sleep, state->iomodule, 300);
+    unlink(state->path);
+    CAIO_FINALLY(self);
+}
+
+
+int
+main() {
+    int fd;
+    int exitstatus = EXIT_SUCCESS;
+    struct caio *c;
+    struct caio_iomodule *iom = NULL;
+    struct caio_inotify *inotify = NULL;
+    struct watcher watcher = {.path = FILENAME};
+    struct writer writer = {.path = FILENAME, .count = 3};
+
+    fd = open(FILENAME, O_CREAT | O_TRUNC | O_WRONLY, 0600);
+    if (fd == -1) {
+        err(EXIT_FAILURE, "open: %s", FILENAME);
+    }
+    close(fd);
+
+    /* Two tasks and the inotify dispatcher */
+    c = caio_create(3);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef CAIO_EPOLL
+    iom = (struct caio_iomodule*)caio_epoll_create(c, 3, 10);
+#elif defined(CAIO_SELECT)
+    iom = (struct caio_iomodule*)caio_select_create(c, 64, 10000);
+#endif
+    if (iom == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    inotify = caio_inotify_create(c, iom, 1);
+    if (inotify == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    if (caio_sleep_create(&writer.sleep)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    watcher.inotify = inotify;
+    writer.iomodule = iom;
+    watcher_spawn(c, watcherA, &watcher);
+    writer_spawn(c, writerA, &writer);
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    caio_sleep_destroy(&writer.sleep);
+
+terminate:
+    caio_inotify_destroy(c, inotify);
+
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(c, (struct caio_epoll*)iom);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(c, (struct caio_select*)iom);
+#endif
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
@@ -0,0 +1,212 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * A prefork TCP echo server, the listener is bound once by the supervisor
+ * and shared among the workers.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/prefork.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define WORKERS 4
+#define MAXCONN 8
+#define BUFFSIZE 1024
+
+
+typedef struct tcpserver {
+    int fd;
+    unsigned int worker;
+    struct caio_iomodule *iomodule;
+} tcpserver_t;
+
+
+typedef struct tcpconn {
+    int fd;
+    char buff[BUFFSIZE];
+    size_t bufflen;
+    struct tcpserver *server;
+} tcpconn_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY tcpserver
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY tcpconn
+#include "caio/generic.h"  // NOLINT
+#include "caio/generic.c"  // NOLINT
+
+
+static struct tcpserver _server;
+
+
+static ASYNC
+echoA(struct caio_task *self, struct tcpconn *conn) {
+    ssize_t bytes;
+    struct tcpserver *server = conn->server;
+    CAIO_BEGIN(self);
+
+    while (true) {
+reading:
+        bytes = read(conn->fd, conn->buff, BUFFSIZE);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(server->iomodule, self, conn->fd, CAIO_IN);
+            goto reading;
+        }
+        else if (bytes <= 0) {
+            CAIO_THROW(self, errno);
+        }
+        conn->bufflen = bytes;
+
+writing:
+        bytes = write(conn->fd, conn->buff, conn->bufflen);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(server->iomodule, self, conn->fd, CAIO_OUT);
+            goto writing;
+        }
+        else if (bytes <= 0) {
+            CAIO_THROW(self, errno);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    if (conn->fd != -1) {
+        CAIO_FILE_FORGET(server->iomodule, conn->fd);
+        close(conn->fd);
+    }
+    free(conn);
+}
+
+
+static ASYNC
+acceptA(struct caio_task *self, struct tcpserver *state) {
+    int connfd;
+    struct tcpconn *c;
+    CAIO_BEGIN(self);
+
+    while (true) {
+        connfd = accept4(state->fd, NULL, NULL, SOCK_NONBLOCK);
+        if ((connfd == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(state->iomodule, self, state->fd, CAIO_IN);
+            continue;
+        }
+
+        if (connfd == -1) {
+            warn("accept4\n");
+            CAIO_THROW(self, errno);
+        }
+
+        printf("Worker #%u accepted fd: %d\n", state->worker, connfd);
+        c = malloc(sizeof(struct tcpconn));
+        if (c == NULL) {
+            close(connfd);
+            continue;
+        }
+
+        c->fd = connfd;
+        c->server = state;
+        if (tcpconn_spawn(self->caio, echoA, c)) {
+            warn("Maximum connection exceeded, fd: %d\n", connfd);
+            close(connfd);
+            free(c);
+        }
+    }
+
+    CAIO_FINALLY(self);
+    CAIO_FILE_FORGET(state->iomodule, state->fd);
+}
+
+
+static int
+_setup(struct caio *c, unsigned int index, void *arg) {
+    int fd = *(int *)arg;
+
+    _server.fd = fd;
+    _server.worker = index;
+#ifdef CAIO_EPOLL
+    _server.iomodule = (struct caio_iomodule*)caio_epoll_create(c,
+            MAXCONN + 1, 1);
+#elif defined(CAIO_SELECT)
+    _server.iomodule = (struct caio_iomodule*)caio_select_create(c,
+            fd + MAXCONN + 1, 1000);
+#endif
+    if (_server.iomodule == NULL) {
+        return -1;
+    }
+
+    return tcpserver_spawn(c, acceptA, &_server);
+}
+
+
+int
+main() {
+    int fd;
+    int option = 1;
+    struct sockaddr_in bindaddr = {
+        .sin_family = AF_INET,
+        .sin_addr = {htons(0)},
+        .sin_port = htons(3030),
+    };
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd == -1) {
+        err(EXIT_FAILURE, "socket");
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    if (bind(fd, (struct sockaddr *)&bindaddr, sizeof(bindaddr))) {
+        err(EXIT_FAILURE, "bind");
+    }
+
+    if (listen(fd, MAXCONN)) {
+        err(EXIT_FAILURE, "listen");
+    }
+
+    printf("Listening on: tcp://0.0.0.0:3030 with %d workers\n", WORKERS);
+    if (caio_prefork(WORKERS, MAXCONN + 1, _setup, &fd)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Spawn some child processes, read their stdout and await their exit.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <sys/wait.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/process.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define CHILDREN 3
+#define BUFFSIZE 256
+
+
+typedef struct child {
+    char *const *argv;
+    struct caio_process process;
+    struct caio_iomodule *iomodule;
+} child_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY child
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static ASYNC
+childA(struct caio_task *self, struct child *state) {
+    ssize_t bytes;
+    char buff[BUFFSIZE];
+    struct caio_process *p = &state->process;
+    CAIO_BEGIN(self);
+
+    CAIO_SPAWN_PROCESS(self, p, state->argv);
+    if (CAIO_HASERROR(self)) {
+        warn("spawn: %s", state->argv[0]);
+        CAIO_RETHROW(self);
+    }
+
+    while (true) {
+        bytes = read(p->out, buff, BUFFSIZE - 1);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            CAIO_FILE_AWAIT(state->iomodule, self, p->out, CAIO_IN);
+            continue;
+        }
+
+        if (bytes <= 0) {
+            break;
+        }
+
+        buff[bytes] = 0;
+        printf("pid: %d, stdout: %s", p->pid, buff);
+    }
+
+    CAIO_FILE_FORGET(state->iomodule, p->out);
+    CAIO_WAITPID(self, p, state->iomodule);
+    if (CAIO_HASERROR(self)) {
+        CAIO_RETHROW(self);
+    }
+    printf("%s exited with status: %d\n", state->argv[0],
+            WEXITSTATUS(p->status));
+
+    CAIO_FINALLY(self);
+    caio_process_close(&state->process);
+}
+
+
+int
+main() {
+    int i;
+    int exitstatus = EXIT_SUCCESS;
+    struct caio *c;
+    struct caio_iomodule *iom = NULL;
+    static char *const argv[CHILDREN][4] = {
+        {"echo", "Hello", NULL},
+        {"sh", "-c", "sleep 1; echo World", NULL},
+        {"sh", "-c", "echo Bye; exit 3", NULL},
+    };
+    struct child children[CHILDREN];
+
+    c = caio_create(CHILDREN);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef CAIO_EPOLL
+    iom = (struct caio_iomodule*)caio_epoll_create(c, CHILDREN, 10);
+#elif defined(CAIO_SELECT)
+    iom = (struct caio_iomodule*)caio_select_create(c, 64, 10000);
+#endif
+    if (iom == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    for (i = 0; i < CHILDREN; i++) {
+        children[i].argv = argv[i];
+        children[i].iomodule = iom;
+        caio_process_init(&children[i].process, CAIO_PROCESS_STDOUT);
+        child_spawn(c, childA, &children[i]);
+    }
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+terminate:
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(c, (struct caio_epoll*)iom);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(c, (struct caio_select*)iom);
+#endif
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
@@ -0,0 +1,149 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Many tasks sharing a token bucket, the achieved rate converges to the
+ * configured one after the initial burst.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/timer.h"
+#include "caio/ratelimit.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define WORKERS 50
+#define REQUESTS 100
+#define RATE 2000
+#define BURST 100
+
+
+typedef struct worker {
+    int index;
+    int count;
+    struct caio_ratelimit *ratelimit;
+} worker_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY worker
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static unsigned long _acquired;
+
+
+static ASYNC
+workerA(struct caio_task *self, struct worker *state) {
+    CAIO_BEGIN(self);
+    for (state->count = 0; state->count < REQUESTS; state->count++) {
+        CAIO_RATELIMIT_ACQUIRE(self, state->ratelimit, 1);
+        _acquired++;
+    }
+    CAIO_FINALLY(self);
+    caio_ratelimit_forget(state->ratelimit, self);
+    if (CAIO_HASERROR(self)) {
+        warnx("worker %d: %s", state->index, strerror(self->eno));
+    }
+}
+
+
+int
+main() {
+    int i;
+    int exitstatus = EXIT_SUCCESS;
+    struct caio *c;
+    struct caio_iomodule *iom = NULL;
+    struct caio_timers *timers = NULL;
+    struct caio_ratelimit *ratelimit = NULL;
+    struct worker workers[WORKERS];
+    unsigned long long started;
+    double elapsed;
+
+    /* Workers and the timers dispatcher */
+    c = caio_create(WORKERS + 1);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef CAIO_EPOLL
+    iom = (struct caio_iomodule*)caio_epoll_create(c, 1, 1);
+#elif defined(CAIO_SELECT)
+    iom = (struct caio_iomodule*)caio_select_create(c, 1, 1000);
+#endif
+    if (iom == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    timers = caio_timers_create(c, iom, 1);
+    if (timers == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    ratelimit = caio_ratelimit_create(c, timers, RATE, BURST, WORKERS);
+    if (ratelimit == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    for (i = 0; i < WORKERS; i++) {
+        workers[i].index = i;
+        workers[i].ratelimit = ratelimit;
+        worker_spawn(c, workerA, &workers[i]);
+    }
+
+    started = caio_now(c);
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+    elapsed = (caio_now(c) - started) / 1e9;
+
+    printf("acquired: %lu, elapsed: %.3fs, rate: %.1f/s, expected: %.1f/s\n",
+            _acquired, elapsed, (_acquired - BURST) / elapsed, (double)RATE);
+
+terminate:
+    caio_ratelimit_destroy(ratelimit);
+    caio_timers_destroy(timers);
+
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(c, (struct caio_epoll*)iom);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(c, (struct caio_select*)iom);
+#endif
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
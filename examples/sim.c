@@ -0,0 +1,231 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * A request/response scenario on the virtual time simulation IO module, with
+ * the faults injected. Hours of virtual time pass in milliseconds, and the
+ * same seed always yields the same output:
+ *
+ *     ./sim 42
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/sim.h"
+
+
+#define MSGSIZE 8
+#define REQUESTS 1000
+#define MS 1000000ULL
+
+
+typedef struct peer {
+    const char *name;
+    int fd;
+    int count;
+    size_t done;
+    char buff[MSGSIZE];
+    unsigned long eagains;
+    struct caio_sim *sim;
+} peer_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY peer
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static ASYNC
+writeA(struct caio_task *self, struct peer *p) {
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    p->done = 0;
+    while (p->done < MSGSIZE) {
+        bytes = caio_sim_write(p->sim, p->fd, p->buff + p->done,
+                MSGSIZE - p->done);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            p->eagains++;
+            CAIO_FILE_AWAIT((struct caio_iomodule*)p->sim, self, p->fd,
+                    CAIO_OUT);
+            continue;
+        }
+
+        if (bytes == -1) {
+            CAIO_THROW(self, errno);
+        }
+        p->done += bytes;
+    }
+
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+readA(struct caio_task *self, struct peer *p) {
+    ssize_t bytes;
+    CAIO_BEGIN(self);
+
+    p->done = 0;
+    while (p->done < MSGSIZE) {
+        bytes = caio_sim_read(p->sim, p->fd, p->buff + p->done,
+                MSGSIZE - p->done);
+        if ((bytes == -1) && IO_MUSTWAIT(errno)) {
+            p->eagains++;
+            CAIO_FILE_AWAIT((struct caio_iomodule*)p->sim, self, p->fd,
+                    CAIO_IN);
+            continue;
+        }
+
+        if (bytes <= 0) {
+            CAIO_THROW(self, bytes ? errno : EPIPE);
+        }
+        p->done += bytes;
+    }
+
+    CAIO_FINALLY(self);
+}
+
+
+static ASYNC
+serverA(struct caio_task *self, struct peer *p) {
+    CAIO_BEGIN(self);
+
+    while (true) {
+        CAIO_AWAIT(self, peer, readA, p);
+        if (CAIO_HASERROR(self)) {
+            CAIO_THROW(self, self->eno);
+        }
+
+        /* Processing takes 1-50ms */
+        CAIO_SIM_SLEEP(p->sim, self, (1 + caio_sim_random(p->sim) % 50) * MS);
+        CAIO_AWAIT(self, peer, writeA, p);
+        if (CAIO_HASERROR(self)) {
+            CAIO_THROW(self, self->eno);
+        }
+        p->count++;
+    }
+
+    CAIO_FINALLY(self);
+    if (self->eno != EPIPE) {
+        printf("%s: %s\n", p->name, strerror(self->eno));
+    }
+    caio_sim_close(p->sim, p->fd);
+}
+
+
+static ASYNC
+clientA(struct caio_task *self, struct peer *p) {
+    CAIO_BEGIN(self);
+
+    while (p->count < REQUESTS) {
+        snprintf(p->buff, MSGSIZE, "%07d", p->count);
+        CAIO_AWAIT(self, peer, writeA, p);
+        if (CAIO_HASERROR(self)) {
+            CAIO_THROW(self, self->eno);
+        }
+
+        CAIO_AWAIT(self, peer, readA, p);
+        if (CAIO_HASERROR(self)) {
+            CAIO_THROW(self, self->eno);
+        }
+
+        if (atoi(p->buff) != p->count) {
+            CAIO_THROW(self, EPROTO);
+        }
+        p->count++;
+
+        /* Think time */
+        CAIO_SIM_SLEEP(p->sim, self, (caio_sim_random(p->sim) % 10000) * MS);
+    }
+
+    CAIO_FINALLY(self);
+    if (self->eno) {
+        printf("%s: %s\n", p->name, strerror(self->eno));
+    }
+    caio_sim_close(p->sim, p->fd);
+}
+
+
+int
+main(int argc, char **argv) {
+    int fds[2];
+    struct caio *c;
+    struct caio_sim *sim;
+    struct timespec start;
+    struct timespec end;
+    int exitstatus = EXIT_SUCCESS;
+    unsigned long long seed = argc > 1 ? atoll(argv[1]) : 0;
+    struct caio_simfaults faults = {
+        .eagain = .1,
+        .partial = .3,
+        .delay = .2,
+        .maxdelay_ns = 10 * MS,
+        .defer = .2,
+    };
+    struct peer server = {.name = "server"};
+    struct peer client = {.name = "client"};
+
+    c = caio_create(2);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    sim = caio_sim_create(c, 8, seed);
+    if ((sim == NULL) || caio_sim_faults(sim, &faults) ||
+            caio_sim_socketpair(sim, MSGSIZE / 2, fds) ||
+            caio_clock_set(c, (caio_clock)caio_sim_now, sim)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    server.sim = client.sim = sim;
+    server.fd = fds[0];
+    client.fd = fds[1];
+    peer_spawn(c, serverA, &server);
+    peer_spawn(c, clientA, &client);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    printf("seed: %llu, requests: %d, served: %d, eagains: %lu/%lu\n", seed,
+            client.count, server.count, client.eagains, server.eagains);
+    printf("virtual time: %.3fs, real time: %.3fs\n",
+            caio_sim_now(sim) / 1e9,
+            (end.tv_sec - start.tv_sec) +
+            (end.tv_nsec - start.tv_nsec) / 1e9);
+
+terminate:
+    caio_sim_destroy(c, sim);
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
@@ -24,6 +24,7 @@
 
 typedef struct foo {
     caio_sleep_t sleep;
+    caio_nsleep_t nsleep;
     time_t delay;
 } foo_t;
 
@@ -56,6 +57,11 @@ fooA(struct caio_task *self, foo_t *state) {
 #ifdef CAIO_EPOLL
     printf("EPOLL: Waiting %ld miliseconds\n", state->delay);
     CAIO_SLEEP(self, &state->sleep, _epoll, state->delay);
+
+    /* Microsecond accurate, by spinning for the last 50us */
+    printf("EPOLL: Waiting 250 microseconds\n");
+    caio_nsleep_spin(&state->nsleep, 50000);
+    CAIO_NSLEEP(self, &state->nsleep, _epoll, 250000);
 #endif
 
 #ifdef CAIO_SELECT
@@ -97,7 +103,7 @@ main() {
     }
 #endif
 
-    if (caio_sleep_create(&foo.sleep)) {
+    if (caio_sleep_create(&foo.sleep) || caio_nsleep_create(&foo.nsleep)) {
         exitstatus = EXIT_FAILURE;
         goto terminate;
     }
@@ -113,6 +119,10 @@ terminate:
         exitstatus = EXIT_FAILURE;
     }
 
+    if (caio_nsleep_destroy(&foo.nsleep)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
 #ifdef CAIO_EPOLL
     if (caio_epoll_destroy(_caio, _epoll)) {
         exitstatus = EXIT_FAILURE;
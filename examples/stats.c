@@ -0,0 +1,188 @@
+// Copyright 2023 Vahid Mardani
+/*
+ * This file is part of caio.
+ *  caio is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  caio is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with caio. If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  Author: Vahid Mardani <vahid.mardani@gmail.com>
+ *
+ *
+ * Share the loop statistics through a memory mapped page, and read them
+ * back from a forked observer process.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+#include <sys/wait.h>
+
+#include "caio/config.h"
+#include "caio/caio.h"
+#include "caio/sleep.h"
+#include "caio/stats.h"
+
+#ifdef CAIO_EPOLL
+#include "caio/epoll.h"
+#elif defined(CAIO_SELECT)
+#include "caio/select.h"
+#endif
+
+
+#define STATSFILE "/dev/shm/caio-stats-example"
+#define WORKERS 4
+
+
+typedef struct worker {
+    int count;
+    time_t delay;
+    caio_sleep_t sleep;
+    struct caio_iomodule *iomodule;
+} worker_t;
+
+
+#undef CAIO_ARG1
+#undef CAIO_ARG2
+#undef CAIO_ENTITY
+#define CAIO_ENTITY worker
+#include "caio/generic.h"
+#include "caio/generic.c"
+
+
+static ASYNC
+workerA(struct caio_task *self, struct worker *state) {
+    CAIO_BEGIN(self);
+    while (state->count--) {
+        CAIO_SLEEP(self, &state->sleep, state->iomodule, state->delay);
+    }
+    CAIO_FINALLY(self);
+}
+
+
+static void
+_print(const struct caio_stats *s) {
+    printf("ticks: %lu, steps: %lu, runnable: %zu, tasks: %zu/%zu, "
+            "spawnfailures: %lu, frames: %lu/%lu, waits: %lu, events: %lu, "
+            "ctls: %lu, waitms: %llu, waitingfiles: %zu\n",
+            s->ticks, s->steps, s->runnable, s->tasks, s->maxtasks,
+            s->spawnfailures, s->frames, s->framefrees, s->io.waits,
+            s->io.events, s->io.ctls, s->io.waitns / 1000000,
+            s->io.waitingfiles);
+}
+
+
+static void
+_observe() {
+    int i;
+    struct caio_stats stats;
+    const struct caio_statspage *page;
+
+    for (i = 0; i < 5; i++) {
+        usleep(500000);
+        page = caio_stats_attach(STATSFILE);
+        if (page == NULL) {
+            continue;
+        }
+
+        caio_stats_read(page, &stats);
+        printf("observer: ");
+        _print(&stats);
+        caio_stats_detach(page);
+
+        /* Ask the loop to dump it's tasks once */
+        if (i == 2) {
+            caio_stats_requestdump(STATSFILE);
+        }
+    }
+}
+
+
+int
+main() {
+    int i;
+    pid_t pid;
+    int exitstatus = EXIT_SUCCESS;
+    struct caio *c;
+    struct caio_stats stats;
+    struct caio_iomodule *iom = NULL;
+    struct worker workers[WORKERS];
+
+    c = caio_create(WORKERS);
+    if (c == NULL) {
+        return EXIT_FAILURE;
+    }
+
+#ifdef CAIO_EPOLL
+    iom = (struct caio_iomodule*)caio_epoll_create(c, WORKERS, 10);
+#elif defined(CAIO_SELECT)
+    iom = (struct caio_iomodule*)caio_select_create(c, 64, 10000);
+#endif
+    if (iom == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+    if (caio_stats_share(c, STATSFILE)) {
+        warn("caio_stats_share: %s", STATSFILE);
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+    caio_dump_trigger(c, 0, stdout);
+
+    for (i = 0; i < WORKERS; i++) {
+        workers[i].count = i + 1;
+        workers[i].delay = 1000;
+        workers[i].iomodule = iom;
+        caio_sleep_create(&workers[i].sleep);
+        worker_spawn(c, workerA, &workers[i]);
+    }
+
+    /* One more than the pool size */
+    if (worker_spawn(c, workerA, &workers[0]) == 0) {
+        warnx("Unexpected spawn");
+    }
+
+    pid = fork();
+    if (pid == 0) {
+        _observe();
+        exit(EXIT_SUCCESS);
+    }
+
+    if (caio_loop(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    if (pid > 0) {
+        waitpid(pid, NULL, 0);
+    }
+
+    caio_stats_get(c, &stats);
+    printf("final:    ");
+    _print(&stats);
+
+    for (i = 0; i < WORKERS; i++) {
+        caio_sleep_destroy(&workers[i].sleep);
+    }
+
+terminate:
+#ifdef CAIO_EPOLL
+    caio_epoll_destroy(c, (struct caio_epoll*)iom);
+#elif defined(CAIO_SELECT)
+    caio_select_destroy(c, (struct caio_select*)iom);
+#endif
+
+    if (caio_destroy(c)) {
+        exitstatus = EXIT_FAILURE;
+    }
+
+    return exitstatus;
+}
@@ -38,10 +38,30 @@
 #include "caio/select.h"
 #endif
 
+#ifdef CAIO_TIMER
+#include "caio/timer.h"
+#endif
+
+#ifdef CAIO_PROFILE
+#include "caio/profile.h"
+#endif
+
+#ifdef CAIO_SAMPLER
+#include "caio/sampler.h"
+#endif
+
+#ifdef CAIO_TRACE
+#include "caio/trace.h"
+#endif
+
 
 #define MAXCONN 8
 #define BUFFSIZE 1024
 
+/* Idle connections are closed after 30 seconds, give or take one */
+#define IDLE_TIMEOUT 30000000000ULL
+#define IDLE_SLACK 1000000000ULL
+
 
 static struct caio *_caio;
 static struct sigaction oldaction;
@@ -51,6 +71,9 @@ static struct sigaction oldaction;
 typedef struct tcpserver {
     int sessions;
     struct caio_iomodule *iomodule;
+#ifdef CAIO_TIMER
+    struct caio_timers *timers;
+#endif
 } tcpserver_t;
 
 
@@ -62,6 +85,11 @@ typedef struct tcpconn {
     char buff[BUFFSIZE];
     size_t bufflen;
     struct tcpserver *server;
+#ifdef CAIO_TIMER
+    struct caio_task *task;
+    struct caio_timer idle;
+    bool idleexpired;
+#endif
 } tcpconn_t;
 
 
@@ -106,12 +134,31 @@ _handlesignals() {
 }
 
 
+#ifdef CAIO_TIMER
+static void
+_idle_expired(struct caio_timer *t, void *arg) {
+    struct tcpconn *conn = arg;
+
+    conn->idleexpired = true;
+    caio_timer_kill(t, conn->task);
+}
+#endif
+
+
 static ASYNC
 echoA(struct caio_task *self, struct tcpconn *conn) {
     ssize_t bytes;
     struct tcpserver *server = conn->server;
     CAIO_BEGIN(self);
 
+#ifdef CAIO_TIMER
+    conn->task = self;
+    if (caio_timer_start(server->timers, &conn->idle, IDLE_TIMEOUT,
+                IDLE_SLACK)) {
+        CAIO_THROW(self, errno);
+    }
+#endif
+
     while (true) {
 reading:
         /* tcp read */
@@ -129,6 +176,9 @@ reading:
             CAIO_THROW(self, errno);
         }
         conn->bufflen = bytes;
+#ifdef CAIO_TIMER
+        caio_timer_touch(server->timers, &conn->idle, IDLE_TIMEOUT);
+#endif
 
 writing:
         /* tcp write */
@@ -148,6 +198,12 @@ writing:
     }
 
     CAIO_FINALLY(self);
+#ifdef CAIO_TIMER
+    caio_timer_stop(server->timers, &conn->idle);
+    if (conn->idleexpired) {
+        warnx("Idle timeout, fd: %d", conn->fd);
+    }
+#endif
     if (conn->fd != -1) {
         CAIO_FILE_FORGET(server->iomodule, conn->fd);
         close(conn->fd);
@@ -201,6 +257,15 @@ listenA(struct caio_task *self, struct tcpserver *state,
             CAIO_THROW(self, errno);
         }
 
+#ifdef CAIO_LAG
+        /* Fast-reject while the loop is overloaded */
+        if (caio_shed(_caio)) {
+            warnx("Overloaded, rejecting: "ADDRFMTS"\n", ADDRFMTV(connaddr));
+            close(connfd);
+            continue;
+        }
+#endif
+
         /* New Connection */
         printf("New connection from: "ADDRFMTS"\n", ADDRFMTV(connaddr));
         struct tcpconn *c = malloc(sizeof(struct tcpconn));
@@ -213,6 +278,12 @@ listenA(struct caio_task *self, struct tcpserver *state,
         c->localaddr = bindaddr;
         c->remoteaddr = connaddr;
         c->server = state;
+#ifdef CAIO_TIMER
+        /* The call may be dropped from the admission queue before it's
+         * first step, and it's finally block stops the timer anyway */
+        caio_timer_init(&c->idle, _idle_expired, c);
+        c->idleexpired = false;
+#endif
         state->sessions++;
         if (tcpconn_spawn(_caio, echoA, c)) {
             warn("Maximum connection exceeded, fd: %d\n", connfd);
@@ -245,12 +316,29 @@ main() {
         return EXIT_FAILURE;
     }
 
-    _caio = caio_create(MAXCONN + 1);
+    /* Connections, the listener and the timers dispatcher */
+    _caio = caio_create(MAXCONN + 2);
     if (_caio == NULL) {
         exitstatus = EXIT_FAILURE;
         goto terminate;
     }
 
+    /* kill -USR1 <pid> to see what each connection is waiting for */
+    caio_dump_trigger(_caio, SIGUSR1, stderr);
+
+    /* Queue up to MAXCONN connections for at most 5 seconds when all the
+     * tasks are busy, instead of rejecting them immediately. */
+    if (caio_admission(_caio, MAXCONN, 5000000000ULL,
+                CAIO_ADMISSION_DROPNEWEST)) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+
+#ifdef CAIO_LAG
+    /* Shed when p99 of the loop lag exceeds 10ms */
+    caio_shed_threshold(_caio, 99, 10000000);
+#endif
+
 #ifdef CAIO_EPOLL
     struct caio_epoll *epoll;
     epoll = caio_epoll_create(_caio, MAXCONN + 1, 1);
@@ -273,13 +361,56 @@ main() {
 
 #endif
 
+#ifdef CAIO_TIMER
+    state.timers = caio_timers_create(_caio, state.iomodule, MAXCONN);
+    if (state.timers == NULL) {
+        exitstatus = EXIT_FAILURE;
+        goto terminate;
+    }
+#endif
+
     tcpserver_spawn(_caio, listenA, &state, bindaddr, MAXCONN);
 
+#ifdef CAIO_SAMPLER
+    /* Flame graph: flamegraph.pl tcpserver.folded > tcpserver.svg */
+    caio_sampler_start(997, 100000);
+#endif
+
+#ifdef CAIO_TRACE
+    /* Open in ui.perfetto.dev or chrome://tracing */
+    caio_trace_start(_caio, 65536);
+#endif
+
     if (caio_loop(_caio)) {
         exitstatus = EXIT_FAILURE;
     }
 
+#ifdef CAIO_TRACE
+    FILE *trace = fopen("tcpserver.trace.json", "w");
+    if (trace) {
+        caio_trace_dump(_caio, trace);
+        fclose(trace);
+    }
+#endif
+
+#ifdef CAIO_SAMPLER
+    caio_sampler_stop();
+    FILE *folded = fopen("tcpserver.folded", "w");
+    if (folded) {
+        caio_sampler_dump(folded);
+        fclose(folded);
+    }
+#endif
+
+#ifdef CAIO_PROFILE
+    caio_profile_dump(stdout, 10);
+#endif
+
 terminate:
+#ifdef CAIO_TIMER
+    caio_timers_destroy(state.timers);
+#endif
+
 #ifdef CAIO_EPOLL
 
     if (caio_epoll_destroy(_caio, epoll)) {
@@ -58,7 +58,7 @@ static struct caio *_caio;
 
 static int
 maketmr(unsigned int interval) {
-    int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK);
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
     if (fd == -1) {
         return -1;
     }